@@ -0,0 +1,243 @@
+#include <benchmark/benchmark.h>
+#include <classes/notext.h>
+#include <classes/extended.h>
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#ifdef CYCLEBUFFER_HAVE_BOOST
+#include <boost/circular_buffer.hpp>
+#endif
+
+// Every benchmark is instantiated for CCircularBuffer, CCircularBufferExt and the standard
+// containers that support the operation, plus boost::circular_buffer when it is available.
+// Args are element counts (or capacities); elements are either int or a 64-byte record.
+
+struct Record {
+    int64_t key;
+    char payload[56];
+};
+
+template<class T>
+T make_value(size_t i) {
+    if constexpr (std::is_same_v<T, Record>) {
+        Record record {};
+        record.key = i;
+        return record;
+    } else {
+        return T(i);
+    }
+}
+
+template<class T>
+int64_t key(const T& value) {
+    if constexpr (std::is_same_v<T, Record>) {
+        return value.key;
+    } else {
+        return value;
+    }
+}
+
+// How each container is created with room for `capacity` elements and how it grows its capacity.
+template<class C>
+struct Traits {
+    static C make(size_t capacity) {
+        C cont;
+        cont.reserve(capacity);
+        return cont;
+    }
+
+    static void reserve(C& cont, size_t capacity) {
+        cont.reserve(capacity);
+    }
+};
+
+template<class T>
+struct Traits<std::deque<T>> {
+    static std::deque<T> make(size_t) {
+        return {};
+    }
+};
+
+#ifdef CYCLEBUFFER_HAVE_BOOST
+template<class T>
+struct Traits<boost::circular_buffer<T>> {
+    static boost::circular_buffer<T> make(size_t capacity) {
+        return boost::circular_buffer<T>(capacity);
+    }
+
+    static void reserve(boost::circular_buffer<T>& cont, size_t capacity) {
+        cont.set_capacity(capacity);
+    }
+};
+#endif
+
+// n elements; in containers with pop_front they start in the middle of the storage, so that ring buffers are wrapped.
+template<class C>
+C make_filled(size_t n, size_t capacity) {
+    typedef typename C::value_type T;
+    C cont = Traits<C>::make(capacity);
+    if constexpr (requires { cont.pop_front(); }) {
+        for (size_t i = 0; i < n / 2; i++) {
+            cont.push_back(make_value<T>(i));
+        }
+        for (size_t i = 0; i < n / 2; i++) {
+            cont.pop_front();
+        }
+    }
+    for (size_t i = 0; i < n; i++) {
+        cont.push_back(make_value<T>(i));
+    }
+    return cont;
+}
+
+// Steady-state FIFO traffic on a half-full buffer of the given capacity.
+template<class C>
+void BM_PushPop(benchmark::State& state) {
+    typedef typename C::value_type T;
+    size_t capacity = state.range(0);
+    C cont = make_filled<C>(capacity / 2, capacity);
+    size_t i = 0;
+    for (auto _ : state) {
+        cont.push_back(make_value<T>(i++));
+        cont.pop_front();
+    }
+    benchmark::DoNotOptimize(cont.front());
+    state.SetItemsProcessed(state.iterations());
+}
+
+template<class C>
+void BM_Iterate(benchmark::State& state) {
+    size_t n = state.range(0);
+    C cont = make_filled<C>(n, n);
+    for (auto _ : state) {
+        int64_t sum = 0;
+        for (const auto& value : cont) {
+            sum += key(value);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+
+template<class C>
+void BM_Index(benchmark::State& state) {
+    size_t n = state.range(0);
+    C cont = make_filled<C>(n, n);
+    for (auto _ : state) {
+        int64_t sum = 0;
+        for (size_t i = 0; i < n; i++) {
+            sum += key(cont[i]);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+
+template<class C>
+void BM_InsertEraseMiddle(benchmark::State& state) {
+    typedef typename C::value_type T;
+    size_t n = state.range(0);
+    C cont = make_filled<C>(n, n + 1);
+    for (auto _ : state) {
+        cont.insert(cont.begin() + n / 2, make_value<T>(n));
+        cont.erase(cont.begin() + n / 2);
+    }
+    benchmark::DoNotOptimize(cont.front());
+    state.SetItemsProcessed(state.iterations());
+}
+
+template<class C>
+void BM_Reserve(benchmark::State& state) {
+    size_t n = state.range(0);
+    C source = make_filled<C>(n, n);
+    for (auto _ : state) {
+        state.PauseTiming();
+        C cont = source;
+        state.ResumeTiming();
+        Traits<C>::reserve(cont, 2 * n);
+        benchmark::DoNotOptimize(cont.front());
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+
+// Filling an empty container that has to grow, which CCircularBufferExt does by doubling.
+template<class C>
+void BM_Growth(benchmark::State& state) {
+    typedef typename C::value_type T;
+    size_t n = state.range(0);
+    for (auto _ : state) {
+        C cont;
+        for (size_t i = 0; i < n; i++) {
+            cont.push_back(make_value<T>(i));
+        }
+        benchmark::DoNotOptimize(cont.back());
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+
+template<class C>
+void BM_Copy(benchmark::State& state) {
+    size_t n = state.range(0);
+    C source = make_filled<C>(n, n);
+    for (auto _ : state) {
+        C cont(source);
+        benchmark::DoNotOptimize(cont.front());
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+
+template<class C>
+void BM_Assign(benchmark::State& state) {
+    size_t n = state.range(0);
+    C source = make_filled<C>(n, n);
+    C cont = make_filled<C>(n, n);
+    for (auto _ : state) {
+        cont = source;
+        benchmark::DoNotOptimize(cont.front());
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+
+#define CYCLEBUFFER_SIZES RangeMultiplier(64)->Range(64, 1 << 18)
+
+#ifdef CYCLEBUFFER_HAVE_BOOST
+#define CYCLEBUFFER_BOOST(bench, T) BENCHMARK_TEMPLATE(bench, boost::circular_buffer<T>)->CYCLEBUFFER_SIZES;
+#else
+#define CYCLEBUFFER_BOOST(bench, T)
+#endif
+
+// std::vector has no O(1) pop_front, so it takes part only where its operations match.
+#define CYCLEBUFFER_RINGS(bench, T)                                              \
+    BENCHMARK_TEMPLATE(bench, CCircularBuffer<T>)->CYCLEBUFFER_SIZES;            \
+    BENCHMARK_TEMPLATE(bench, CCircularBufferExt<T>)->CYCLEBUFFER_SIZES;         \
+    BENCHMARK_TEMPLATE(bench, std::deque<T>)->CYCLEBUFFER_SIZES;                 \
+    CYCLEBUFFER_BOOST(bench, T)
+
+#define CYCLEBUFFER_ALL(bench, T)                                                \
+    CYCLEBUFFER_RINGS(bench, T)                                                  \
+    BENCHMARK_TEMPLATE(bench, std::vector<T>)->CYCLEBUFFER_SIZES;
+
+CYCLEBUFFER_RINGS(BM_PushPop, int)
+CYCLEBUFFER_RINGS(BM_PushPop, Record)
+CYCLEBUFFER_ALL(BM_Iterate, int)
+CYCLEBUFFER_ALL(BM_Iterate, Record)
+CYCLEBUFFER_ALL(BM_Index, int)
+CYCLEBUFFER_ALL(BM_InsertEraseMiddle, int)
+CYCLEBUFFER_ALL(BM_InsertEraseMiddle, Record)
+CYCLEBUFFER_ALL(BM_Copy, int)
+CYCLEBUFFER_ALL(BM_Assign, int)
+CYCLEBUFFER_ALL(BM_Copy, Record)
+
+BENCHMARK_TEMPLATE(BM_Reserve, CCircularBuffer<int>)->CYCLEBUFFER_SIZES;
+BENCHMARK_TEMPLATE(BM_Reserve, CCircularBufferExt<int>)->CYCLEBUFFER_SIZES;
+BENCHMARK_TEMPLATE(BM_Reserve, std::vector<int>)->CYCLEBUFFER_SIZES;
+CYCLEBUFFER_BOOST(BM_Reserve, int)
+
+BENCHMARK_TEMPLATE(BM_Growth, CCircularBufferExt<int>)->CYCLEBUFFER_SIZES;
+BENCHMARK_TEMPLATE(BM_Growth, CCircularBufferExt<Record>)->CYCLEBUFFER_SIZES;
+BENCHMARK_TEMPLATE(BM_Growth, std::vector<int>)->CYCLEBUFFER_SIZES;
+BENCHMARK_TEMPLATE(BM_Growth, std::vector<Record>)->CYCLEBUFFER_SIZES;
+BENCHMARK_TEMPLATE(BM_Growth, std::deque<int>)->CYCLEBUFFER_SIZES;
+BENCHMARK_TEMPLATE(BM_Growth, std::deque<Record>)->CYCLEBUFFER_SIZES;
@@ -0,0 +1,258 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "notext.h"
+
+// Bounded queue for any number of threads with blocking and timed push/pop.
+// The elements live in a CCircularBuffer guarded by a mutex that is held only while
+// one element is moved in or out. Sleeping happens on two event counters, bumped after
+// every push and every pop: a waiter spins briefly on the counter and then sleeps on it
+// with a futex. Wakeups are issued only when the waiter count of that side is non-zero,
+// so a queue that keeps up costs no system calls beyond the uncontended mutex.
+// The spin length adapts: it doubles when spinning was enough and halves when it was not.
+template<class T, class A = std::allocator<T>>
+class CCircularBufferBlocking {
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex words must be plain 32-bit integers");
+
+public:
+    typedef typename A::size_type size_type;
+    typedef std::chrono::steady_clock clock;
+
+    CCircularBufferBlocking(const size_t capacity);
+    CCircularBufferBlocking(const CCircularBufferBlocking&) = delete;
+    CCircularBufferBlocking& operator=(const CCircularBufferBlocking&) = delete;
+
+    // A value passed as an rvalue is moved from only when it is actually pushed.
+    template<class U>
+    bool try_push(U&& value);
+    template<class U>
+    void push(U&& value);
+    template<class U, class Rep, class Period>
+    bool push_for(U&& value, const std::chrono::duration<Rep, Period>& timeout);
+    template<class U>
+    bool push_until(U&& value, const clock::time_point& deadline);
+
+    bool try_pop(T& value);
+    void pop(T& value);
+    template<class Rep, class Period>
+    bool pop_for(T& value, const std::chrono::duration<Rep, Period>& timeout);
+    bool pop_until(T& value, const clock::time_point& deadline);
+
+    bool empty() const;
+    size_type size() const;
+    size_type capacity() const;
+
+protected:
+    static constexpr size_t cacheLine = 64;
+    static constexpr uint32_t minSpin = 16;
+    static constexpr uint32_t maxSpin = 4096;
+
+    template<class U>
+    bool push_wait(U&& value, const clock::time_point* deadline);
+    bool pop_wait(T& value, const clock::time_point* deadline);
+    bool await(std::atomic<uint32_t>& events, std::atomic<uint32_t>& waiters, uint32_t seen,
+               const clock::time_point* deadline);
+    static bool sleep(std::atomic<uint32_t>& word, uint32_t seen, const clock::time_point* deadline);
+    static void wake(std::atomic<uint32_t>& word);
+    static void relax();
+
+    CCircularBuffer<T, A> ring_;
+    std::mutex mutex_;
+    std::atomic<size_t> size_;
+    std::atomic<uint32_t> spin_;
+
+    alignas(cacheLine) std::atomic<uint32_t> pushes_;
+    std::atomic<uint32_t> popWaiters_;
+
+    alignas(cacheLine) std::atomic<uint32_t> pops_;
+    std::atomic<uint32_t> pushWaiters_;
+};
+
+template<class T, class A>
+CCircularBufferBlocking<T, A>::CCircularBufferBlocking(const size_t capacity): size_(0), spin_(minSpin), pushes_(0),
+                                                                               popWaiters_(0), pops_(0), pushWaiters_(0) {
+    ring_.reserve(capacity);
+    ring_.set_full_policy(CFullPolicy::Reject);
+}
+
+template<class T, class A>
+void CCircularBufferBlocking<T, A>::relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Returns false only when the deadline passed; spurious and real wakeups both return true.
+template<class T, class A>
+bool CCircularBufferBlocking<T, A>::sleep(std::atomic<uint32_t>& word, uint32_t seen, const clock::time_point* deadline) {
+    timespec timeout;
+    if (deadline != nullptr) {
+        auto left = *deadline - clock::now();
+        if (left <= clock::duration::zero()) {
+            return false;
+        }
+        auto seconds = std::chrono::duration_cast<std::chrono::seconds>(left);
+        timeout.tv_sec = seconds.count();
+        timeout.tv_nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(left - seconds).count();
+    }
+    // FUTEX_WAIT takes a relative timeout measured on CLOCK_MONOTONIC, the clock behind steady_clock
+    long result = syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, seen,
+                          deadline != nullptr ? &timeout : nullptr, nullptr, 0);
+    if (result != 0 && errno == ETIMEDOUT) {
+        return false;
+    }
+    return true;
+}
+
+template<class T, class A>
+void CCircularBufferBlocking<T, A>::wake(std::atomic<uint32_t>& word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
+
+// Waits until events moves past seen. The waiter is registered before the final check of
+// events, and the other side bumps events before reading the waiter count, so with
+// sequentially consistent operations either the check sees the new event or the wakeup is sent.
+template<class T, class A>
+bool CCircularBufferBlocking<T, A>::await(std::atomic<uint32_t>& events, std::atomic<uint32_t>& waiters, uint32_t seen,
+                                          const clock::time_point* deadline) {
+    uint32_t limit = spin_.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < limit; i++) {
+        if (events.load(std::memory_order_relaxed) != seen) {
+            spin_.store(std::min(limit * 2, maxSpin), std::memory_order_relaxed);
+            return true;
+        }
+        relax();
+    }
+    spin_.store(std::max(limit / 2, minSpin), std::memory_order_relaxed);
+    waiters.fetch_add(1);
+    bool alive = true;
+    if (events.load() == seen) {
+        alive = sleep(events, seen, deadline);
+    }
+    waiters.fetch_sub(1);
+    return alive;
+}
+
+template<class T, class A>
+template<class U>
+bool CCircularBufferBlocking<T, A>::try_push(U&& value) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!ring_.try_emplace_back(std::forward<U>(value))) {
+            return false;
+        }
+        size_.store(ring_.size(), std::memory_order_relaxed);
+    }
+    pushes_.fetch_add(1);
+    if (popWaiters_.load() != 0) {
+        wake(pushes_);
+    }
+    return true;
+}
+
+template<class T, class A>
+template<class U>
+bool CCircularBufferBlocking<T, A>::push_wait(U&& value, const clock::time_point* deadline) {
+    for (;;) {
+        uint32_t seen = pops_.load();
+        if (try_push(std::forward<U>(value))) {
+            return true;
+        }
+        if (!await(pops_, pushWaiters_, seen, deadline)) {
+            return try_push(std::forward<U>(value));
+        }
+    }
+}
+
+template<class T, class A>
+template<class U>
+void CCircularBufferBlocking<T, A>::push(U&& value) {
+    push_wait(std::forward<U>(value), nullptr);
+}
+
+template<class T, class A>
+template<class U, class Rep, class Period>
+bool CCircularBufferBlocking<T, A>::push_for(U&& value, const std::chrono::duration<Rep, Period>& timeout) {
+    return push_until(std::forward<U>(value), clock::now() + std::chrono::ceil<clock::duration>(timeout));
+}
+
+template<class T, class A>
+template<class U>
+bool CCircularBufferBlocking<T, A>::push_until(U&& value, const clock::time_point& deadline) {
+    return push_wait(std::forward<U>(value), &deadline);
+}
+
+template<class T, class A>
+bool CCircularBufferBlocking<T, A>::try_pop(T& value) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (ring_.empty()) {
+            return false;
+        }
+        value = std::move(ring_.front());
+        ring_.pop_front();
+        size_.store(ring_.size(), std::memory_order_relaxed);
+    }
+    pops_.fetch_add(1);
+    if (pushWaiters_.load() != 0) {
+        wake(pops_);
+    }
+    return true;
+}
+
+template<class T, class A>
+bool CCircularBufferBlocking<T, A>::pop_wait(T& value, const clock::time_point* deadline) {
+    for (;;) {
+        uint32_t seen = pushes_.load();
+        if (try_pop(value)) {
+            return true;
+        }
+        if (!await(pushes_, popWaiters_, seen, deadline)) {
+            return try_pop(value);
+        }
+    }
+}
+
+template<class T, class A>
+void CCircularBufferBlocking<T, A>::pop(T& value) {
+    pop_wait(value, nullptr);
+}
+
+template<class T, class A>
+template<class Rep, class Period>
+bool CCircularBufferBlocking<T, A>::pop_for(T& value, const std::chrono::duration<Rep, Period>& timeout) {
+    return pop_until(value, clock::now() + std::chrono::ceil<clock::duration>(timeout));
+}
+
+template<class T, class A>
+bool CCircularBufferBlocking<T, A>::pop_until(T& value, const clock::time_point& deadline) {
+    return pop_wait(value, &deadline);
+}
+
+template<class T, class A>
+bool CCircularBufferBlocking<T, A>::empty() const {
+    return size() == 0;
+}
+
+template<class T, class A>
+typename CCircularBufferBlocking<T, A>::size_type CCircularBufferBlocking<T, A>::size() const {
+    return size_.load(std::memory_order_relaxed);
+}
+
+template<class T, class A>
+typename CCircularBufferBlocking<T, A>::size_type CCircularBufferBlocking<T, A>::capacity() const {
+    return ring_.capacity();
+}
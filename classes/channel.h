@@ -0,0 +1,361 @@
+#pragma once
+
+#include <coroutine>
+#include <optional>
+#include <utility>
+
+#include "notext.h"
+
+// A coroutine suspended on a channel: first in the channel's wait list, then, once its
+// operation has been completed for it, in the run queue of its thread.
+class CChannelWaiter {
+protected:
+    template<class, class> friend class CCircularBufferChannel;
+
+    // the run queue of this thread and whether a channel call further up the stack is emptying it
+    static inline thread_local CChannelWaiter* readyHead_ = nullptr;
+    static inline thread_local CChannelWaiter* readyTail_ = nullptr;
+    static inline thread_local bool running_ = false;
+
+    std::coroutine_handle<> handle_;
+    CChannelWaiter* next_ = nullptr;
+    bool waiting_ = false;
+    bool ready_ = false;
+};
+
+// Bounded channel for coroutines running on one thread: co_await push(value) and
+// co_await pop() suspend instead of blocking when the buffer is full or empty.
+// Buffered values live in a CCircularBuffer; suspended coroutines wait in intrusive FIFO lists
+// threaded through their awaiters, which live in the coroutine frames, so awaiting never allocates.
+// The operation that frees a slot or supplies a value completes the first waiter's operation: a pop
+// moves the first waiting producer's value into the freed slot, a push into an empty channel
+// with waiting consumers hands its value straight to the first of them.
+// close() wakes everybody: pushes then fail and pops drain what is left and then return nullopt.
+// Woken coroutines are not resumed from inside the operation that woke them but queued in a run
+// queue shared by all channels of the thread, which the outermost channel call empties in order,
+// so a chain of wakeups runs one coroutine after the other at constant stack depth.
+// A coroutine destroyed while suspended on a channel takes its awaiter out of the lists; other
+// suspended coroutines must be resumed or destroyed before the channel is.
+template<class T, class A = std::allocator<T>>
+class CCircularBufferChannel {
+public:
+    typedef typename A::size_type size_type;
+
+    class PushAwaiter : public CChannelWaiter {
+    public:
+        friend class CCircularBufferChannel<T, A>;
+
+        PushAwaiter(const PushAwaiter&) = delete;
+        PushAwaiter& operator=(const PushAwaiter&) = delete;
+        ~PushAwaiter();
+
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> handle);
+        // false when the channel was closed and the value was not delivered
+        bool await_resume();
+
+    protected:
+        PushAwaiter(CCircularBufferChannel* channel, T&& value);
+
+        CCircularBufferChannel* channel_;
+        T value_;
+        bool delivered_;
+    };
+
+    class PopAwaiter : public CChannelWaiter {
+    public:
+        friend class CCircularBufferChannel<T, A>;
+
+        PopAwaiter(const PopAwaiter&) = delete;
+        PopAwaiter& operator=(const PopAwaiter&) = delete;
+        ~PopAwaiter();
+
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> handle);
+        std::optional<T> await_resume();
+
+    protected:
+        PopAwaiter(CCircularBufferChannel* channel);
+
+        CCircularBufferChannel* channel_;
+        std::optional<T> value_;
+    };
+
+    CCircularBufferChannel(const size_t capacity);
+    CCircularBufferChannel(const CCircularBufferChannel&) = delete;
+    CCircularBufferChannel& operator=(const CCircularBufferChannel&) = delete;
+
+    PushAwaiter push(T value);
+    PopAwaiter pop();
+
+    // Non-suspending versions; they fail instead of waiting.
+    bool try_push(T&& value);
+    bool try_push(const T& value);
+    std::optional<T> try_pop();
+
+    void close();
+    bool closed() const;
+    bool empty() const;
+    size_type size() const;
+    size_type capacity() const;
+
+protected:
+    template<class W>
+    static void enqueue(W*& head, W*& tail, W* waiter);
+    template<class W>
+    static W* dequeue(W*& head, W*& tail);
+    template<class W>
+    static void unlink(W*& head, W*& tail, W* waiter);
+    template<class W>
+    static void forget(W*& head, W*& tail, W* waiter);
+    static void wake(CChannelWaiter* waiter);
+    static void run();
+
+    bool take(std::optional<T>& value);
+    bool give(T& value);
+
+    CCircularBuffer<T, A> ring_;
+    bool closed_;
+    PushAwaiter* pushHead_;
+    PushAwaiter* pushTail_;
+    PopAwaiter* popHead_;
+    PopAwaiter* popTail_;
+};
+
+template<class T, class A>
+CCircularBufferChannel<T, A>::CCircularBufferChannel(const size_t capacity): closed_(false), pushHead_(nullptr),
+                                                                             pushTail_(nullptr), popHead_(nullptr), popTail_(nullptr) {
+    ring_.reserve(capacity);
+    ring_.set_full_policy(CFullPolicy::Reject);
+}
+
+template<class T, class A>
+template<class W>
+void CCircularBufferChannel<T, A>::enqueue(W*& head, W*& tail, W* waiter) {
+    waiter->next_ = nullptr;
+    if (tail == nullptr) {
+        head = waiter;
+    } else {
+        tail->next_ = waiter;
+    }
+    tail = waiter;
+}
+
+template<class T, class A>
+template<class W>
+W* CCircularBufferChannel<T, A>::dequeue(W*& head, W*& tail) {
+    W* waiter = head;
+    if (waiter != nullptr) {
+        head = static_cast<W*>(waiter->next_);
+        if (head == nullptr) {
+            tail = nullptr;
+        }
+    }
+    return waiter;
+}
+
+template<class T, class A>
+template<class W>
+void CCircularBufferChannel<T, A>::unlink(W*& head, W*& tail, W* waiter) {
+    W* prev = nullptr;
+    for (W* w = head; w != waiter; w = static_cast<W*>(w->next_)) {
+        prev = w;
+    }
+    W* next = static_cast<W*>(waiter->next_);
+    if (prev == nullptr) {
+        head = next;
+    } else {
+        prev->next_ = next;
+    }
+    if (tail == waiter) {
+        tail = prev;
+    }
+}
+
+// Called by an awaiter that goes away, normally after its coroutine was resumed,
+// but also when the coroutine is destroyed while still waiting or queued to run.
+template<class T, class A>
+template<class W>
+void CCircularBufferChannel<T, A>::forget(W*& head, W*& tail, W* waiter) {
+    if (waiter->waiting_) {
+        unlink(head, tail, waiter);
+    } else if (waiter->ready_) {
+        unlink<CChannelWaiter>(CChannelWaiter::readyHead_, CChannelWaiter::readyTail_, waiter);
+    }
+}
+
+// Queues a waiter whose operation is done; unless a channel call further up the stack is
+// already running the queue, runs it before returning.
+template<class T, class A>
+void CCircularBufferChannel<T, A>::wake(CChannelWaiter* waiter) {
+    waiter->waiting_ = false;
+    waiter->ready_ = true;
+    enqueue(CChannelWaiter::readyHead_, CChannelWaiter::readyTail_, waiter);
+    if (!CChannelWaiter::running_) {
+        run();
+    }
+}
+
+template<class T, class A>
+void CCircularBufferChannel<T, A>::run() {
+    CChannelWaiter::running_ = true;
+    while (CChannelWaiter* waiter = dequeue(CChannelWaiter::readyHead_, CChannelWaiter::readyTail_)) {
+        waiter->ready_ = false;
+        waiter->handle_.resume();
+    }
+    CChannelWaiter::running_ = false;
+}
+
+// Hands the value to the first waiting consumer or buffers it; the value is moved from only on success.
+template<class T, class A>
+bool CCircularBufferChannel<T, A>::give(T& value) {
+    if (closed_) {
+        return false;
+    }
+    if (PopAwaiter* consumer = dequeue(popHead_, popTail_)) {
+        consumer->value_.emplace(std::move(value));
+        wake(consumer);
+        return true;
+    }
+    return ring_.try_push_back(std::move(value));
+}
+
+// Takes the oldest value; the slot it frees goes to the first waiting producer.
+template<class T, class A>
+bool CCircularBufferChannel<T, A>::take(std::optional<T>& value) {
+    PushAwaiter* producer = dequeue(pushHead_, pushTail_);
+    if (!ring_.empty()) {
+        value.emplace(std::move(ring_.front()));
+        ring_.pop_front();
+        if (producer != nullptr) {
+            ring_.push_back(std::move(producer->value_));
+        }
+    } else if (producer != nullptr) {
+        // zero capacity: the value goes straight from producer to consumer
+        value.emplace(std::move(producer->value_));
+    } else {
+        return false;
+    }
+    if (producer != nullptr) {
+        producer->delivered_ = true;
+        wake(producer);
+    }
+    return true;
+}
+
+template<class T, class A>
+typename CCircularBufferChannel<T, A>::PushAwaiter CCircularBufferChannel<T, A>::push(T value) {
+    return PushAwaiter(this, std::move(value));
+}
+
+template<class T, class A>
+typename CCircularBufferChannel<T, A>::PopAwaiter CCircularBufferChannel<T, A>::pop() {
+    return PopAwaiter(this);
+}
+
+template<class T, class A>
+bool CCircularBufferChannel<T, A>::try_push(T&& value) {
+    // producers already waiting keep their turn
+    return pushHead_ == nullptr && give(value);
+}
+
+template<class T, class A>
+bool CCircularBufferChannel<T, A>::try_push(const T& value) {
+    T copy(value);
+    return try_push(std::move(copy));
+}
+
+template<class T, class A>
+std::optional<T> CCircularBufferChannel<T, A>::try_pop() {
+    std::optional<T> value;
+    take(value);
+    return value;
+}
+
+template<class T, class A>
+void CCircularBufferChannel<T, A>::close() {
+    closed_ = true;
+    bool outermost = !CChannelWaiter::running_;
+    CChannelWaiter::running_ = true;
+    while (PushAwaiter* producer = dequeue(pushHead_, pushTail_)) {
+        wake(producer);
+    }
+    while (PopAwaiter* consumer = dequeue(popHead_, popTail_)) {
+        wake(consumer);
+    }
+    if (outermost) {
+        run();
+    }
+}
+
+template<class T, class A>
+bool CCircularBufferChannel<T, A>::closed() const {
+    return closed_;
+}
+
+template<class T, class A>
+bool CCircularBufferChannel<T, A>::empty() const {
+    return ring_.empty();
+}
+
+template<class T, class A>
+typename CCircularBufferChannel<T, A>::size_type CCircularBufferChannel<T, A>::size() const {
+    return ring_.size();
+}
+
+template<class T, class A>
+typename CCircularBufferChannel<T, A>::size_type CCircularBufferChannel<T, A>::capacity() const {
+    return ring_.capacity();
+}
+
+template<class T, class A>
+CCircularBufferChannel<T, A>::PushAwaiter::PushAwaiter(CCircularBufferChannel* channel, T&& value): channel_(channel),
+        value_(std::move(value)), delivered_(false) {}
+
+template<class T, class A>
+CCircularBufferChannel<T, A>::PushAwaiter::~PushAwaiter() {
+    forget(channel_->pushHead_, channel_->pushTail_, this);
+}
+
+template<class T, class A>
+bool CCircularBufferChannel<T, A>::PushAwaiter::await_ready() {
+    delivered_ = channel_->try_push(std::move(value_));
+    return delivered_ || channel_->closed_;
+}
+
+template<class T, class A>
+void CCircularBufferChannel<T, A>::PushAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    this->handle_ = handle;
+    this->waiting_ = true;
+    enqueue(channel_->pushHead_, channel_->pushTail_, this);
+}
+
+template<class T, class A>
+bool CCircularBufferChannel<T, A>::PushAwaiter::await_resume() {
+    return delivered_;
+}
+
+template<class T, class A>
+CCircularBufferChannel<T, A>::PopAwaiter::PopAwaiter(CCircularBufferChannel* channel): channel_(channel) {}
+
+template<class T, class A>
+CCircularBufferChannel<T, A>::PopAwaiter::~PopAwaiter() {
+    forget(channel_->popHead_, channel_->popTail_, this);
+}
+
+template<class T, class A>
+bool CCircularBufferChannel<T, A>::PopAwaiter::await_ready() {
+    return channel_->take(value_) || channel_->closed_;
+}
+
+template<class T, class A>
+void CCircularBufferChannel<T, A>::PopAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    this->handle_ = handle;
+    this->waiting_ = true;
+    enqueue(channel_->popHead_, channel_->popTail_, this);
+}
+
+template<class T, class A>
+std::optional<T> CCircularBufferChannel<T, A>::PopAwaiter::await_resume() {
+    return std::move(value_);
+}
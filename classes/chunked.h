@@ -0,0 +1,614 @@
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <type_traits>
+
+// Growable ring made of fixed-size chunks linked into a list, like a deque without its map.
+// Growth links one more chunk and draining unlinks chunks, so push and pop are O(1) in the
+// worst case and elements never move. Unlinked chunks go to a small per-instance pool and are
+// reused by the next growth; chunks beyond the pool limit are returned to the allocator.
+// Indexing walks the chunk list; bulk code should go through for_each_chunk().
+template<class T, class A = std::allocator<T>, size_t ChunkSize = std::max<size_t>(16, 4096 / sizeof(T))>
+class CCircularBufferChunked {
+    static_assert(ChunkSize > 0, "chunks must hold at least one element");
+
+    struct Chunk {
+        Chunk* prev;
+        Chunk* next;
+        alignas(T) unsigned char storage[ChunkSize * sizeof(T)];
+
+        T* data() {
+            return reinterpret_cast<T*>(storage);
+        }
+    };
+
+    typedef typename std::allocator_traits<A>::template rebind_alloc<Chunk> ChunkAlloc;
+
+public:
+    typedef ptrdiff_t difference_type;
+    typedef size_t size_type;
+
+    typedef T value_type;
+    typedef T& reference;
+    typedef const T& const_reference;
+
+    template<bool isConst>
+    class BaseIterator {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef ptrdiff_t difference_type;
+        typedef std::conditional_t<isConst, const T*, T*> pointer;
+        typedef std::conditional_t<isConst, const T&, T&> reference;
+
+        friend class CCircularBufferChunked<T, A, ChunkSize>;
+        template<bool> friend class BaseIterator;
+
+        BaseIterator();
+        BaseIterator(Chunk* chunk, size_t index);
+        template<bool wasConst> requires (isConst && !wasConst)
+        BaseIterator(const BaseIterator<wasConst>& it);
+
+        reference operator*() const;
+        pointer operator->() const;
+
+        BaseIterator& operator++();
+        BaseIterator operator++(int);
+        BaseIterator& operator--();
+        BaseIterator operator--(int);
+
+        template<bool otherConst>
+        bool operator==(const BaseIterator<otherConst>& other) const;
+
+    protected:
+        Chunk* chunk_;
+        size_t index_;
+    };
+
+    typedef BaseIterator<false> Iterator;
+    typedef BaseIterator<true> const_Iterator;
+    typedef Iterator iterator;
+    typedef const_Iterator const_iterator;
+    typedef std::reverse_iterator<Iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_Iterator> const_reverse_iterator;
+
+    CCircularBufferChunked();
+    CCircularBufferChunked(const std::initializer_list<T>& il);
+    CCircularBufferChunked(const CCircularBufferChunked& cont);
+    CCircularBufferChunked(CCircularBufferChunked&& cont) noexcept;
+
+    ~CCircularBufferChunked();
+
+    CCircularBufferChunked& operator=(const CCircularBufferChunked& cont);
+    CCircularBufferChunked& operator=(CCircularBufferChunked&& cont) noexcept;
+
+    Iterator begin();
+    const_Iterator begin() const;
+    const_Iterator cbegin() const;
+    Iterator end();
+    const_Iterator end() const;
+    const_Iterator cend() const;
+    reverse_iterator rbegin();
+    const_reverse_iterator rbegin() const;
+    reverse_iterator rend();
+    const_reverse_iterator rend() const;
+
+    T& front();
+    const T& front() const;
+    T& back();
+    const T& back() const;
+    T& operator[](size_type index);
+    const T& operator[](size_type index) const;
+
+    void push_front(const T& value);
+    void push_front(T&& value);
+    template<class... Args>
+    void emplace_front(Args&&... args);
+    void pop_front();
+
+    void push_back(const T& elem);
+    void push_back(T&& elem);
+    template<class... Args>
+    void emplace_back(Args&&... args);
+    void pop_back();
+
+    // Calls fn with one std::span per chunk, front to back.
+    template<class Fn>
+    void for_each_chunk(Fn fn);
+    template<class Fn>
+    void for_each_chunk(Fn fn) const;
+
+    void clear();
+    bool empty() const;
+    size_type size() const;
+    size_type chunk_count() const;
+    static constexpr size_type chunk_size();
+
+    // Number of free chunks kept for reuse; shrink_to_fit() returns all of them.
+    void set_pool_limit(size_t chunks);
+    size_type pool_size() const;
+    void shrink_to_fit();
+
+    void swap(CCircularBufferChunked& cont) noexcept;
+
+protected:
+    Chunk* acquire();
+    void recycle(Chunk* chunk);
+    T* locate(size_t index) const;
+
+    ChunkAlloc alloc;
+    Chunk* first_;
+    Chunk* last_;
+    size_t head_;
+    size_t tail_;
+    size_t size_;
+    size_t chunks_;
+    Chunk* pool_;
+    size_t poolSize_;
+    size_t poolLimit_;
+};
+
+template<class T, class A, size_t ChunkSize>
+CCircularBufferChunked<T, A, ChunkSize>::CCircularBufferChunked(): first_(nullptr), last_(nullptr), head_(0), tail_(0),
+        size_(0), chunks_(0), pool_(nullptr), poolSize_(0), poolLimit_(1) {}
+
+template<class T, class A, size_t ChunkSize>
+CCircularBufferChunked<T, A, ChunkSize>::CCircularBufferChunked(const std::initializer_list<T>& il): CCircularBufferChunked() {
+    for (const T& value : il) {
+        emplace_back(value);
+    }
+}
+
+template<class T, class A, size_t ChunkSize>
+CCircularBufferChunked<T, A, ChunkSize>::CCircularBufferChunked(const CCircularBufferChunked& cont): CCircularBufferChunked() {
+    poolLimit_ = cont.poolLimit_;
+    for (const T& value : cont) {
+        emplace_back(value);
+    }
+}
+
+template<class T, class A, size_t ChunkSize>
+CCircularBufferChunked<T, A, ChunkSize>::CCircularBufferChunked(CCircularBufferChunked&& cont) noexcept: CCircularBufferChunked() {
+    swap(cont);
+}
+
+template<class T, class A, size_t ChunkSize>
+CCircularBufferChunked<T, A, ChunkSize>::~CCircularBufferChunked() {
+    clear();
+    shrink_to_fit();
+}
+
+template<class T, class A, size_t ChunkSize>
+CCircularBufferChunked<T, A, ChunkSize>& CCircularBufferChunked<T, A, ChunkSize>::operator=(const CCircularBufferChunked& cont) {
+    if (this != &cont) {
+        CCircularBufferChunked temp(cont);
+        swap(temp);
+    }
+    return *this;
+}
+
+template<class T, class A, size_t ChunkSize>
+CCircularBufferChunked<T, A, ChunkSize>& CCircularBufferChunked<T, A, ChunkSize>::operator=(CCircularBufferChunked&& cont) noexcept {
+    CCircularBufferChunked temp(std::move(cont));
+    swap(temp);
+    return *this;
+}
+
+template<class T, class A, size_t ChunkSize>
+typename CCircularBufferChunked<T, A, ChunkSize>::Chunk* CCircularBufferChunked<T, A, ChunkSize>::acquire() {
+    Chunk* chunk = pool_;
+    if (chunk != nullptr) {
+        pool_ = chunk->next;
+        poolSize_--;
+    } else {
+        chunk = std::allocator_traits<ChunkAlloc>::allocate(alloc, 1);
+        std::construct_at(chunk);
+    }
+    chunk->prev = nullptr;
+    chunk->next = nullptr;
+    chunks_++;
+    return chunk;
+}
+
+template<class T, class A, size_t ChunkSize>
+void CCircularBufferChunked<T, A, ChunkSize>::recycle(Chunk* chunk) {
+    chunks_--;
+    if (poolSize_ < poolLimit_) {
+        chunk->next = pool_;
+        pool_ = chunk;
+        poolSize_++;
+    } else {
+        std::destroy_at(chunk);
+        std::allocator_traits<ChunkAlloc>::deallocate(alloc, chunk, 1);
+    }
+}
+
+// Walks from whichever end of the chunk list is closer.
+template<class T, class A, size_t ChunkSize>
+T* CCircularBufferChunked<T, A, ChunkSize>::locate(size_t index) const {
+    size_t offset = head_ + index;
+    size_t n = offset / ChunkSize;
+    Chunk* chunk;
+    if (n < chunks_ / 2) {
+        chunk = first_;
+        for (size_t i = 0; i < n; i++) {
+            chunk = chunk->next;
+        }
+    } else {
+        chunk = last_;
+        for (size_t i = chunks_ - 1; i > n; i--) {
+            chunk = chunk->prev;
+        }
+    }
+    return chunk->data() + offset % ChunkSize;
+}
+
+template<class T, class A, size_t ChunkSize>
+typename CCircularBufferChunked<T, A, ChunkSize>::Iterator CCircularBufferChunked<T, A, ChunkSize>::begin() {
+    return Iterator(first_, head_);
+}
+
+template<class T, class A, size_t ChunkSize>
+typename CCircularBufferChunked<T, A, ChunkSize>::const_Iterator CCircularBufferChunked<T, A, ChunkSize>::begin() const {
+    return const_Iterator(first_, head_);
+}
+
+template<class T, class A, size_t ChunkSize>
+typename CCircularBufferChunked<T, A, ChunkSize>::const_Iterator CCircularBufferChunked<T, A, ChunkSize>::cbegin() const {
+    return const_Iterator(first_, head_);
+}
+
+template<class T, class A, size_t ChunkSize>
+typename CCircularBufferChunked<T, A, ChunkSize>::Iterator CCircularBufferChunked<T, A, ChunkSize>::end() {
+    return Iterator(last_, tail_);
+}
+
+template<class T, class A, size_t ChunkSize>
+typename CCircularBufferChunked<T, A, ChunkSize>::const_Iterator CCircularBufferChunked<T, A, ChunkSize>::end() const {
+    return const_Iterator(last_, tail_);
+}
+
+template<class T, class A, size_t ChunkSize>
+typename CCircularBufferChunked<T, A, ChunkSize>::const_Iterator CCircularBufferChunked<T, A, ChunkSize>::cend() const {
+    return const_Iterator(last_, tail_);
+}
+
+template<class T, class A, size_t ChunkSize>
+typename CCircularBufferChunked<T, A, ChunkSize>::reverse_iterator CCircularBufferChunked<T, A, ChunkSize>::rbegin() {
+    return reverse_iterator(end());
+}
+
+template<class T, class A, size_t ChunkSize>
+typename CCircularBufferChunked<T, A, ChunkSize>::const_reverse_iterator CCircularBufferChunked<T, A, ChunkSize>::rbegin() const {
+    return const_reverse_iterator(end());
+}
+
+template<class T, class A, size_t ChunkSize>
+typename CCircularBufferChunked<T, A, ChunkSize>::reverse_iterator CCircularBufferChunked<T, A, ChunkSize>::rend() {
+    return reverse_iterator(begin());
+}
+
+template<class T, class A, size_t ChunkSize>
+typename CCircularBufferChunked<T, A, ChunkSize>::const_reverse_iterator CCircularBufferChunked<T, A, ChunkSize>::rend() const {
+    return const_reverse_iterator(begin());
+}
+
+template<class T, class A, size_t ChunkSize>
+T& CCircularBufferChunked<T, A, ChunkSize>::front() {
+    return first_->data()[head_];
+}
+
+template<class T, class A, size_t ChunkSize>
+const T& CCircularBufferChunked<T, A, ChunkSize>::front() const {
+    return first_->data()[head_];
+}
+
+template<class T, class A, size_t ChunkSize>
+T& CCircularBufferChunked<T, A, ChunkSize>::back() {
+    return last_->data()[tail_ - 1];
+}
+
+template<class T, class A, size_t ChunkSize>
+const T& CCircularBufferChunked<T, A, ChunkSize>::back() const {
+    return last_->data()[tail_ - 1];
+}
+
+template<class T, class A, size_t ChunkSize>
+T& CCircularBufferChunked<T, A, ChunkSize>::operator[](size_type index) {
+    return *locate(index);
+}
+
+template<class T, class A, size_t ChunkSize>
+const T& CCircularBufferChunked<T, A, ChunkSize>::operator[](size_type index) const {
+    return *locate(index);
+}
+
+template<class T, class A, size_t ChunkSize>
+void CCircularBufferChunked<T, A, ChunkSize>::push_front(const T& value) {
+    emplace_front(value);
+}
+
+template<class T, class A, size_t ChunkSize>
+void CCircularBufferChunked<T, A, ChunkSize>::push_front(T&& value) {
+    emplace_front(std::move(value));
+}
+
+// A new chunk is linked only when the front chunk is used up; an empty buffer
+// starts at the end of its chunk so that further push_front calls fill it.
+// The element is built in the new chunk before the chunk is linked, so a throwing
+// constructor leaves the buffer unchanged.
+template<class T, class A, size_t ChunkSize>
+template<class... Args>
+void CCircularBufferChunked<T, A, ChunkSize>::emplace_front(Args&&... args) {
+    if (first_ != nullptr && head_ != 0) {
+        std::construct_at(first_->data() + head_ - 1, std::forward<Args>(args)...);
+        head_--;
+        size_++;
+        return;
+    }
+    Chunk* chunk = acquire();
+    try {
+        std::construct_at(chunk->data() + ChunkSize - 1, std::forward<Args>(args)...);
+    } catch (...) {
+        recycle(chunk);
+        throw;
+    }
+    if (first_ == nullptr) {
+        first_ = last_ = chunk;
+        tail_ = ChunkSize;
+    } else {
+        chunk->next = first_;
+        first_->prev = chunk;
+        first_ = chunk;
+    }
+    head_ = ChunkSize - 1;
+    size_++;
+}
+
+template<class T, class A, size_t ChunkSize>
+void CCircularBufferChunked<T, A, ChunkSize>::pop_front() {
+    if (size_ == 0) {
+        return;
+    }
+    std::destroy_at(first_->data() + head_);
+    head_++;
+    size_--;
+    if (size_ == 0) {
+        recycle(first_);
+        first_ = last_ = nullptr;
+        head_ = tail_ = 0;
+    } else if (head_ == ChunkSize) {
+        Chunk* chunk = first_;
+        first_ = chunk->next;
+        first_->prev = nullptr;
+        recycle(chunk);
+        head_ = 0;
+    }
+}
+
+template<class T, class A, size_t ChunkSize>
+void CCircularBufferChunked<T, A, ChunkSize>::push_back(const T& elem) {
+    emplace_back(elem);
+}
+
+template<class T, class A, size_t ChunkSize>
+void CCircularBufferChunked<T, A, ChunkSize>::push_back(T&& elem) {
+    emplace_back(std::move(elem));
+}
+
+template<class T, class A, size_t ChunkSize>
+template<class... Args>
+void CCircularBufferChunked<T, A, ChunkSize>::emplace_back(Args&&... args) {
+    if (last_ != nullptr && tail_ != ChunkSize) {
+        std::construct_at(last_->data() + tail_, std::forward<Args>(args)...);
+        tail_++;
+        size_++;
+        return;
+    }
+    Chunk* chunk = acquire();
+    try {
+        std::construct_at(chunk->data(), std::forward<Args>(args)...);
+    } catch (...) {
+        recycle(chunk);
+        throw;
+    }
+    if (last_ == nullptr) {
+        first_ = last_ = chunk;
+        head_ = 0;
+    } else {
+        chunk->prev = last_;
+        last_->next = chunk;
+        last_ = chunk;
+    }
+    tail_ = 1;
+    size_++;
+}
+
+template<class T, class A, size_t ChunkSize>
+void CCircularBufferChunked<T, A, ChunkSize>::pop_back() {
+    if (size_ == 0) {
+        return;
+    }
+    tail_--;
+    size_--;
+    std::destroy_at(last_->data() + tail_);
+    if (size_ == 0) {
+        recycle(last_);
+        first_ = last_ = nullptr;
+        head_ = tail_ = 0;
+    } else if (tail_ == 0) {
+        Chunk* chunk = last_;
+        last_ = chunk->prev;
+        last_->next = nullptr;
+        recycle(chunk);
+        tail_ = ChunkSize;
+    }
+}
+
+template<class T, class A, size_t ChunkSize>
+template<class Fn>
+void CCircularBufferChunked<T, A, ChunkSize>::for_each_chunk(Fn fn) {
+    for (Chunk* chunk = first_; chunk != nullptr; chunk = chunk->next) {
+        size_t from = chunk == first_ ? head_ : 0;
+        size_t to = chunk == last_ ? tail_ : ChunkSize;
+        fn(std::span<T>(chunk->data() + from, to - from));
+    }
+}
+
+template<class T, class A, size_t ChunkSize>
+template<class Fn>
+void CCircularBufferChunked<T, A, ChunkSize>::for_each_chunk(Fn fn) const {
+    for (Chunk* chunk = first_; chunk != nullptr; chunk = chunk->next) {
+        size_t from = chunk == first_ ? head_ : 0;
+        size_t to = chunk == last_ ? tail_ : ChunkSize;
+        fn(std::span<const T>(chunk->data() + from, to - from));
+    }
+}
+
+template<class T, class A, size_t ChunkSize>
+void CCircularBufferChunked<T, A, ChunkSize>::clear() {
+    for_each_chunk([](std::span<T> span) {
+        std::destroy(span.begin(), span.end());
+    });
+    while (first_ != nullptr) {
+        Chunk* chunk = first_;
+        first_ = chunk->next;
+        recycle(chunk);
+    }
+    last_ = nullptr;
+    head_ = tail_ = 0;
+    size_ = 0;
+}
+
+template<class T, class A, size_t ChunkSize>
+bool CCircularBufferChunked<T, A, ChunkSize>::empty() const {
+    return size_ == 0;
+}
+
+template<class T, class A, size_t ChunkSize>
+typename CCircularBufferChunked<T, A, ChunkSize>::size_type CCircularBufferChunked<T, A, ChunkSize>::size() const {
+    return size_;
+}
+
+template<class T, class A, size_t ChunkSize>
+typename CCircularBufferChunked<T, A, ChunkSize>::size_type CCircularBufferChunked<T, A, ChunkSize>::chunk_count() const {
+    return chunks_;
+}
+
+template<class T, class A, size_t ChunkSize>
+constexpr typename CCircularBufferChunked<T, A, ChunkSize>::size_type CCircularBufferChunked<T, A, ChunkSize>::chunk_size() {
+    return ChunkSize;
+}
+
+template<class T, class A, size_t ChunkSize>
+void CCircularBufferChunked<T, A, ChunkSize>::set_pool_limit(size_t chunks) {
+    poolLimit_ = chunks;
+    while (poolSize_ > poolLimit_) {
+        Chunk* chunk = pool_;
+        pool_ = chunk->next;
+        poolSize_--;
+        std::destroy_at(chunk);
+        std::allocator_traits<ChunkAlloc>::deallocate(alloc, chunk, 1);
+    }
+}
+
+template<class T, class A, size_t ChunkSize>
+typename CCircularBufferChunked<T, A, ChunkSize>::size_type CCircularBufferChunked<T, A, ChunkSize>::pool_size() const {
+    return poolSize_;
+}
+
+template<class T, class A, size_t ChunkSize>
+void CCircularBufferChunked<T, A, ChunkSize>::shrink_to_fit() {
+    size_t limit = poolLimit_;
+    set_pool_limit(0);
+    poolLimit_ = limit;
+}
+
+template<class T, class A, size_t ChunkSize>
+void CCircularBufferChunked<T, A, ChunkSize>::swap(CCircularBufferChunked& cont) noexcept {
+    std::swap(alloc, cont.alloc);
+    std::swap(first_, cont.first_);
+    std::swap(last_, cont.last_);
+    std::swap(head_, cont.head_);
+    std::swap(tail_, cont.tail_);
+    std::swap(size_, cont.size_);
+    std::swap(chunks_, cont.chunks_);
+    std::swap(pool_, cont.pool_);
+    std::swap(poolSize_, cont.poolSize_);
+    std::swap(poolLimit_, cont.poolLimit_);
+}
+
+template<class T, class A, size_t ChunkSize>
+template<bool isConst>
+CCircularBufferChunked<T, A, ChunkSize>::BaseIterator<isConst>::BaseIterator(): chunk_(nullptr), index_(0) {}
+
+template<class T, class A, size_t ChunkSize>
+template<bool isConst>
+CCircularBufferChunked<T, A, ChunkSize>::BaseIterator<isConst>::BaseIterator(Chunk* chunk, size_t index): chunk_(chunk), index_(index) {}
+
+template<class T, class A, size_t ChunkSize>
+template<bool isConst>
+template<bool wasConst> requires (isConst && !wasConst)
+CCircularBufferChunked<T, A, ChunkSize>::BaseIterator<isConst>::BaseIterator(const BaseIterator<wasConst>& it): chunk_(it.chunk_), index_(it.index_) {}
+
+template<class T, class A, size_t ChunkSize>
+template<bool isConst>
+typename CCircularBufferChunked<T, A, ChunkSize>::template BaseIterator<isConst>::reference CCircularBufferChunked<T, A, ChunkSize>::BaseIterator<isConst>::operator*() const {
+    return chunk_->data()[index_];
+}
+
+template<class T, class A, size_t ChunkSize>
+template<bool isConst>
+typename CCircularBufferChunked<T, A, ChunkSize>::template BaseIterator<isConst>::pointer CCircularBufferChunked<T, A, ChunkSize>::BaseIterator<isConst>::operator->() const {
+    return chunk_->data() + index_;
+}
+
+// Past the last slot of a chunk the iterator moves to the next chunk; only the
+// last chunk keeps index ChunkSize, which is then its end position.
+template<class T, class A, size_t ChunkSize>
+template<bool isConst>
+typename CCircularBufferChunked<T, A, ChunkSize>::template BaseIterator<isConst>& CCircularBufferChunked<T, A, ChunkSize>::BaseIterator<isConst>::operator++() {
+    index_++;
+    if (index_ == ChunkSize && chunk_->next != nullptr) {
+        chunk_ = chunk_->next;
+        index_ = 0;
+    }
+    return *this;
+}
+
+template<class T, class A, size_t ChunkSize>
+template<bool isConst>
+typename CCircularBufferChunked<T, A, ChunkSize>::template BaseIterator<isConst> CCircularBufferChunked<T, A, ChunkSize>::BaseIterator<isConst>::operator++(int) {
+    BaseIterator temp(*this);
+    ++*this;
+    return temp;
+}
+
+template<class T, class A, size_t ChunkSize>
+template<bool isConst>
+typename CCircularBufferChunked<T, A, ChunkSize>::template BaseIterator<isConst>& CCircularBufferChunked<T, A, ChunkSize>::BaseIterator<isConst>::operator--() {
+    if (index_ == 0) {
+        chunk_ = chunk_->prev;
+        index_ = ChunkSize;
+    }
+    index_--;
+    return *this;
+}
+
+template<class T, class A, size_t ChunkSize>
+template<bool isConst>
+typename CCircularBufferChunked<T, A, ChunkSize>::template BaseIterator<isConst> CCircularBufferChunked<T, A, ChunkSize>::BaseIterator<isConst>::operator--(int) {
+    BaseIterator temp(*this);
+    --*this;
+    return temp;
+}
+
+template<class T, class A, size_t ChunkSize>
+template<bool isConst>
+template<bool otherConst>
+bool CCircularBufferChunked<T, A, ChunkSize>::BaseIterator<isConst>::operator==(const BaseIterator<otherConst>& other) const {
+    return chunk_ == other.chunk_ && index_ == other.index_;
+}
@@ -1,75 +1,885 @@
 #pragma once
 
-#include "classes.h"
+#include "notext.h"
+
+// Raw storage for the first K elements of a CCircularBufferExt.
+template<class T, size_t K>
+struct CInlineStorage {
+    alignas(T) unsigned char bytes[K * sizeof(T)];
+};
+
+template<class T>
+struct CInlineStorage<T, 0> {};
+
+// Automatic shrinking for CCircularBufferExt: when size() has stayed at or below
+// capacity() / lowWater for `patience` consecutive pushes and pops, the capacity is halved,
+// but never below minCapacity. patience == 0 turns shrinking off.
+struct CShrinkPolicy {
+    size_t lowWater = 4;
+    size_t patience = 0;
+    size_t minCapacity = 16;
+};
+
+// Growable buffer: pushes into a full buffer double the capacity instead of overwriting.
+// set_full_policy() can switch an instance back to overwriting or to rejecting pushes.
+// With K > 0 the first K elements live inside the object and the heap is used
+// only once the buffer outgrows them. S is the statistics policy, as for CCircularBuffer.
+// The base class is protected, so a CCircularBufferExt does not convert to a CCircularBuffer
+// behind the back of its own members; code written against the base gets it from as_base().
+template<class T, class A = std::allocator<T>, size_t K = 0, class S = CNoStats>
+class CCircularBufferExt : protected CCircularBuffer<T, A, S> {
+    typedef CCircularBuffer<T, A, S> Base;
 
-template<class T, class A = std::allocator<T>>
-class CCircularBufferExt : public CCircularBuffer<T, A> {
 public:
-    void push_front(const T& value) override;
-    void push_back(const T& elem) override;
+    typedef typename Base::difference_type difference_type;
+    typedef typename Base::size_type size_type;
+    typedef typename Base::value_type value_type;
+    typedef typename Base::reference reference;
+    typedef typename Base::const_reference const_reference;
+
+    // Same iterators as CCircularBuffer's, but dereferenced through this class so that
+    // they also find the elements an incremental growth has not moved yet.
+    template<bool isConst>
+    using BaseIterator = CCircularBufferIterator<CCircularBufferExt, isConst>;
+    template<class, bool> friend class CCircularBufferIterator;
+
+    typedef BaseIterator<false> Iterator;
+    typedef BaseIterator<true> const_Iterator;
+    typedef Iterator iterator;
+    typedef const_Iterator const_iterator;
+    typedef std::reverse_iterator<Iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_Iterator> const_reverse_iterator;
+
+    using Base::push_front;
+    using Base::push_back;
+    using Base::empty;
+    using Base::size;
+    using Base::capacity;
+    using Base::max_size;
+    using Base::set_full_policy;
+    using Base::full_policy;
+    using Base::overwritten;
+    using Base::dropped;
+    using Base::reset_counters;
+    using Base::stats;
+    using Base::stats_policy;
+
+    void push_front(const T& value);
+    void push_front(T&& value);
+    template<class... Args>
+    void emplace_front(Args&&... args);
+    void push_back(const T& elem);
+    void push_back(T&& elem);
+    template<class... Args>
+    void emplace_back(Args&&... args);
+    bool try_push_front(const T& value);
+    bool try_push_front(T&& value);
+    template<class... Args>
+    bool try_emplace_front(Args&&... args);
+    bool try_push_back(const T& elem);
+    bool try_push_back(T&& elem);
+    template<class... Args>
+    bool try_emplace_back(Args&&... args);
+    template<std::forward_iterator iter>
+    void push_front(iter it1, iter it2);
+    template<std::forward_iterator iter>
+    void push_back(iter it1, iter it2);
     template<std::forward_iterator iter>
     CCircularBufferExt(iter it1, iter it2);
     CCircularBufferExt(const std::initializer_list<T>& il);
+    CCircularBufferExt(const CCircularBufferExt& cont);
+    CCircularBufferExt(CCircularBufferExt&& cont) noexcept(std::is_nothrow_move_constructible_v<T>);
     CCircularBufferExt();
     CCircularBufferExt(const size_t size);
-    CCircularBufferExt(const size_t size, const T value);
+    CCircularBufferExt(const size_t size, const T& value);
+    CCircularBufferExt(const size_t capacity, CPow2Capacity);
+
+    ~CCircularBufferExt();
+
+    CCircularBufferExt& operator=(const CCircularBufferExt& cont);
+    CCircularBufferExt& operator=(CCircularBufferExt&& cont) noexcept(std::is_nothrow_move_constructible_v<T>);
+    void swap(CCircularBufferExt& cont);
+
+    // Unlike the base versions these keep inline storage and the full-buffer policy.
+    template<std::forward_iterator iter>
+    void assign(iter it1, iter it2);
+    void assign(std::initializer_list<T> il);
+    void assign(size_t n, const T& t);
+
+    Iterator begin();
+    const_Iterator begin() const;
+    const_Iterator cbegin() const;
+    T& front();
+    const T& front() const;
+    Iterator end();
+    const_Iterator end() const;
+    const_Iterator cend() const;
+    T& back();
+    const T& back() const;
+
+    reverse_iterator rbegin();
+    const_reverse_iterator rbegin() const;
+    const_reverse_iterator crbegin() const;
+    reverse_iterator rend();
+    const_reverse_iterator rend() const;
+    const_reverse_iterator crend() const;
+
+    T& operator[](size_type index);
+    const T& operator[](size_type index) const;
+
+    // Finish a pending migration first, so there are no const overloads.
+    std::span<T> array_one();
+    std::span<T> array_two();
+
+    Iterator insert(Iterator it, const T& data);
+    Iterator insert(Iterator it, T&& data);
+    Iterator insert(Iterator it, size_t n, const T& data);
+    template<class... Args>
+    Iterator emplace(Iterator it, Args&&... args);
+    template<std::forward_iterator iter>
+    Iterator insert(Iterator it, const iter& it1, const iter& it2);
+    Iterator insert(Iterator it, std::initializer_list<T> list);
+
+    Iterator erase(Iterator it);
+    const_Iterator erase(const_Iterator it);
+    Iterator erase(Iterator it1, Iterator it2);
+    const_Iterator erase(const_Iterator it1, const_Iterator it2);
+
+    void pop_front();
+    void pop_back();
+    void pop_front(size_t n);
+    void pop_back(size_t n);
+    template<class iter>
+    size_t copy_out(iter dest, size_t n) const;
+
+    void reserve(size_t newCapacity);
+    void resize(size_t newSize);
+    void clear();
+
+    // Relocates the elements into the smallest block that holds them (or back inline).
+    void shrink_to_fit();
+    void set_shrink_policy(const CShrinkPolicy& policy);
+    const CShrinkPolicy& shrink_policy() const;
+
+    // With step > 0 growth only switches to the new block; the elements are then moved
+    // over `step` at a time by each following push and pop, so no single push copies the
+    // whole buffer. Reads and iteration see the same sequence throughout. Other modifiers
+    // finish an unfinished migration first, and so do array_one(), array_two() and as_base(),
+    // the only ways to see the raw layout. step == 0 (the default) grows in one go.
+    void set_incremental_growth(size_t step);
+    size_t incremental_growth() const;
+    // Finishes an unfinished migration.
+    void settle();
 
+    // The buffer as a CCircularBuffer, after settle(). Pushes through it follow the full-buffer
+    // policy, so they grow by default; it shows the raw layout only until the next push or pop
+    // through this object.
+    Base& as_base();
 
+protected:
+    static T* inline_data(CInlineStorage<T, K>& storage);
+    T* slot(size_t i) const;
+    typename Base::Iterator base_iterator(const_Iterator it);
+    Iterator own_iterator(typename Base::Iterator it);
+    void grow();
+    void begin_migration(size_t newCapacity);
+    void migrate(size_t n);
+    void take(CCircularBufferExt& cont);
+    void replace(CCircularBufferExt& temp);
+    void note_size();
+
+    [[no_unique_address]] CInlineStorage<T, K> storage_;
+    CShrinkPolicy shrink_;
+    size_t lowOps_ = 0;
+    size_t growStep_ = 0;
+    // Incremental growth: while old_ is set, the logical elements [pendingFrom_, pendingFrom_ + pending_)
+    // still live in old_, starting at oldHead_; their slots in data_ are reserved but unconstructed.
+    T* old_ = nullptr;
+    size_t oldCapacity_ = 0;
+    size_t oldHead_ = 0;
+    size_t pendingFrom_ = 0;
+    size_t pending_ = 0;
 };
 
-template<class T, class A>
-void CCircularBufferExt<T, A>::push_front(const T &value) {
-    if(this->capacity_ == 0) {
-        CCircularBufferExt<T, A>::reserve(1);
+template<class T, class A, size_t K, class S>
+T* CCircularBufferExt<T, A, K, S>::inline_data(CInlineStorage<T, K>& storage) {
+    if constexpr (K == 0) {
+        return nullptr;
+    } else {
+        return reinterpret_cast<T*>(storage.bytes);
     }
-    if (this->size_ == this->capacity_) {
-        CCircularBufferExt<T, A>::reserve(2 * this->capacity_);
+}
+
+// Elements an incremental growth has not moved yet are looked up in the old block.
+template<class T, class A, size_t K, class S>
+T* CCircularBufferExt<T, A, K, S>::slot(size_t i) const {
+    if (pending_ != 0 && i - pendingFrom_ < pending_) [[unlikely]] {
+        size_t j = oldHead_ + (i - pendingFrom_);
+        return old_ + (j < oldCapacity_ ? j : j - oldCapacity_);
     }
-    this->begin_ = this->data_ + (this->begin_ - this->data_ + this->capacity_ - 1) % this->capacity_;
-    std::construct_at(this->begin_, value);
-    this->size_++;
-    this->isFull = this->size_ == this->capacity_;
+    return this->data_ + this->wrap(this->head_ + i);
+}
+
+template<class T, class A, size_t K, class S>
+typename CCircularBufferExt<T, A, K, S>::Base::Iterator CCircularBufferExt<T, A, K, S>::base_iterator(const_Iterator it) {
+    return typename Base::Iterator(this, it.index_);
 }
 
-template<class T, class A>
-void CCircularBufferExt<T, A>::push_back(const T &elem) {
-    if(this->capacity_ == 0) {
-        CCircularBufferExt<T, A>::reserve(1);
+template<class T, class A, size_t K, class S>
+typename CCircularBufferExt<T, A, K, S>::Iterator CCircularBufferExt<T, A, K, S>::own_iterator(typename Base::Iterator it) {
+    return Iterator(this, it - Base::begin());
+}
+
+template<class T, class A, size_t K, class S>
+void CCircularBufferExt<T, A, K, S>::grow() {
+    settle();
+    size_t newCapacity = this->capacity_ == 0 ? 1 : 2 * this->capacity_;
+    if (growStep_ == 0 || this->size_ == 0) {
+        this->reallocate(newCapacity, true);
+    } else {
+        this->begin_migration(newCapacity);
     }
+}
+
+// Switches to a new block of at least newCapacity slots without moving anything yet:
+// all elements become pending in the old block and are moved over by migrate().
+template<class T, class A, size_t K, class S>
+void CCircularBufferExt<T, A, K, S>::begin_migration(size_t newCapacity) {
+    if (this->pow2_) {
+        newCapacity = std::bit_ceil(newCapacity);
+    }
+    auto timer = this->stats_.start();
+    T* data_temp = this->allocate(newCapacity, true);
+    old_ = this->data_;
+    oldCapacity_ = this->capacity_;
+    oldHead_ = this->head_;
+    pendingFrom_ = 0;
+    pending_ = this->size_;
+    this->data_ = data_temp;
+    this->capacity_ = newCapacity;
+    this->mask_ = newCapacity - 1;
+    this->head_ = 0;
+    this->stats_.reallocated(timer, 0);
+}
+
+// Moves up to n pending elements into their reserved slots; frees the old block once none are left.
+template<class T, class A, size_t K, class S>
+void CCircularBufferExt<T, A, K, S>::migrate(size_t n) {
+    n = std::min(n, pending_);
+    if (n != 0) {
+        auto timer = this->stats_.start();
+        for (size_t i = 0; i < n; i++) {
+            T* src = old_ + oldHead_;
+            std::construct_at(this->data_ + this->wrap(this->head_ + pendingFrom_), std::move_if_noexcept(*src));
+            std::destroy_at(src);
+            oldHead_ = oldHead_ + 1 == oldCapacity_ ? 0 : oldHead_ + 1;
+            pendingFrom_++;
+            pending_--;
+        }
+        this->stats_.relocated(timer, n * sizeof(T));
+    }
+    if (pending_ == 0 && old_ != nullptr) {
+        if (old_ != this->inline_) {
+            std::allocator_traits<A>::deallocate(this->alloc, old_, oldCapacity_);
+        }
+        old_ = nullptr;
+    }
+}
+
+// Finishes a pending migration before anything that works on the raw layout of data_.
+template<class T, class A, size_t K, class S>
+void CCircularBufferExt<T, A, K, S>::settle() {
+    if (old_ != nullptr) [[unlikely]] {
+        migrate(pending_);
+    }
+}
+
+template<class T, class A, size_t K, class S>
+typename CCircularBufferExt<T, A, K, S>::Base& CCircularBufferExt<T, A, K, S>::as_base() {
+    settle();
+    return *this;
+}
+
+template<class T, class A, size_t K, class S>
+void CCircularBufferExt<T, A, K, S>::push_front(const T &value) {
+    emplace_front(value);
+}
+
+template<class T, class A, size_t K, class S>
+void CCircularBufferExt<T, A, K, S>::push_front(T &&value) {
+    emplace_front(std::move(value));
+}
+
+template<class T, class A, size_t K, class S>
+template<class... Args>
+void CCircularBufferExt<T, A, K, S>::emplace_front(Args&&... args) {
+    try_emplace_front(std::forward<Args>(args)...);
+}
+
+template<class T, class A, size_t K, class S>
+bool CCircularBufferExt<T, A, K, S>::try_push_front(const T& value) {
+    return try_emplace_front(value);
+}
+
+template<class T, class A, size_t K, class S>
+bool CCircularBufferExt<T, A, K, S>::try_push_front(T&& value) {
+    return try_emplace_front(std::move(value));
+}
+
+// When the buffer has to grow the value is built first, so arguments may refer to elements of the buffer.
+template<class T, class A, size_t K, class S>
+template<class... Args>
+bool CCircularBufferExt<T, A, K, S>::try_emplace_front(Args&&... args) {
+    size_t head;
     if (this->size_ == this->capacity_) {
-        CCircularBufferExt<T, A>::reserve(2 * this->capacity_);
+        if (this->full_ != CFullPolicy::Grow) [[unlikely]] {
+            settle();
+            return Base::try_emplace_front(std::forward<Args>(args)...);
+        }
+        T value(std::forward<Args>(args)...);
+        grow();
+        head = this->wrap(this->head_ + this->capacity_ - 1);
+        std::construct_at(this->data_ + head, std::move(value));
+    } else {
+        head = this->wrap(this->head_ + this->capacity_ - 1);
+        std::construct_at(this->data_ + head, std::forward<Args>(args)...);
     }
-    std::construct_at(this->end_, elem);
-    this->end_++;
-    if (this->end_ == this->data_ + this->capacity_) {
-        this->end_ = this->data_;
+    this->head_ = head;
+    this->size_++;
+    this->stats_.pushed_front(1, this->size_);
+    if (this->pending_ != 0) {
+        this->pendingFrom_++;
+    }
+    this->migrate(growStep_);
+    note_size();
+    return true;
+}
+
+template<class T, class A, size_t K, class S>
+void CCircularBufferExt<T, A, K, S>::push_back(const T &elem) {
+    emplace_back(elem);
+}
+
+template<class T, class A, size_t K, class S>
+void CCircularBufferExt<T, A, K, S>::push_back(T &&elem) {
+    emplace_back(std::move(elem));
+}
+
+template<class T, class A, size_t K, class S>
+template<class... Args>
+void CCircularBufferExt<T, A, K, S>::emplace_back(Args&&... args) {
+    try_emplace_back(std::forward<Args>(args)...);
+}
+
+template<class T, class A, size_t K, class S>
+bool CCircularBufferExt<T, A, K, S>::try_push_back(const T& elem) {
+    return try_emplace_back(elem);
+}
+
+template<class T, class A, size_t K, class S>
+bool CCircularBufferExt<T, A, K, S>::try_push_back(T&& elem) {
+    return try_emplace_back(std::move(elem));
+}
+
+template<class T, class A, size_t K, class S>
+template<class... Args>
+bool CCircularBufferExt<T, A, K, S>::try_emplace_back(Args&&... args) {
+    if (this->size_ == this->capacity_) {
+        if (this->full_ != CFullPolicy::Grow) [[unlikely]] {
+            settle();
+            return Base::try_emplace_back(std::forward<Args>(args)...);
+        }
+        T value(std::forward<Args>(args)...);
+        grow();
+        std::construct_at(this->slot(this->size_), std::move(value));
+    } else {
+        std::construct_at(this->slot(this->size_), std::forward<Args>(args)...);
     }
     this->size_++;
-    this->isFull = this->size_ == this->capacity_;
+    this->stats_.pushed_back(1, this->size_);
+    this->migrate(growStep_);
+    note_size();
+    return true;
+}
+
+template<class T, class A, size_t K, class S>
+template<std::forward_iterator iter>
+void CCircularBufferExt<T, A, K, S>::push_front(iter it1, iter it2) {
+    settle();
+    size_t n = std::distance(it1, it2);
+    if (this->size_ + n > this->capacity_ && this->full_ == CFullPolicy::Grow) {
+        this->reallocate(std::max(2 * this->capacity_, this->size_ + n), true);
+    }
+    Base::push_front(it1, it2);
+}
+
+template<class T, class A, size_t K, class S>
+template<std::forward_iterator iter>
+void CCircularBufferExt<T, A, K, S>::push_back(iter it1, iter it2) {
+    settle();
+    size_t n = std::distance(it1, it2);
+    if (this->size_ + n > this->capacity_ && this->full_ == CFullPolicy::Grow) {
+        this->reallocate(std::max(2 * this->capacity_, this->size_ + n), true);
+    }
+    Base::push_back(it1, it2);
+}
+
+template<class T, class A, size_t K, class S>
+template<std::forward_iterator iter>
+CCircularBufferExt<T, A, K, S>::CCircularBufferExt(iter it1, iter it2): Base(inline_data(storage_), K, false) {
+    size_t n = std::distance(it1, it2);
+    if (n > this->capacity_) {
+        this->reserve(n);
+    }
+    Base::push_back(it1, it2);
+}
+
+template<class T, class A, size_t K, class S>
+CCircularBufferExt<T, A, K, S>::CCircularBufferExt(): Base(inline_data(storage_), K, false) {
+}
+
+template<class T, class A, size_t K, class S>
+CCircularBufferExt<T, A, K, S>::CCircularBufferExt(const std::initializer_list<T> &il):
+        CCircularBufferExt(il.begin(), il.end()) {
+}
+
+template<class T, class A, size_t K, class S>
+CCircularBufferExt<T, A, K, S>::CCircularBufferExt(const CCircularBufferExt& cont): Base(inline_data(storage_), K, cont.pow2_),
+        shrink_(cont.shrink_), growStep_(cont.growStep_) {
+    this->full_ = cont.full_;
+    if (cont.capacity_ > this->capacity_) {
+        this->reserve(cont.capacity_);
+    }
+    Base::push_back(cont.begin(), cont.end());
+}
+
+template<class T, class A, size_t K, class S>
+CCircularBufferExt<T, A, K, S>::CCircularBufferExt(CCircularBufferExt&& cont) noexcept(std::is_nothrow_move_constructible_v<T>):
+        Base(inline_data(storage_), K, cont.pow2_) {
+    take(cont);
+}
+
+template<class T, class A, size_t K, class S>
+CCircularBufferExt<T, A, K, S>::CCircularBufferExt(const size_t size): Base(inline_data(storage_), K, false) {
+    if (size > this->capacity_) {
+        this->reserve(size);
+    }
+    for (size_t i = 0; i < size; i++) {
+        Base::emplace_back();
+    }
+}
+
+template<class T, class A, size_t K, class S>
+CCircularBufferExt<T, A, K, S>::CCircularBufferExt(const size_t size, const T& value): Base(inline_data(storage_), K, false) {
+    if (size > this->capacity_) {
+        this->reserve(size);
+    }
+    for (size_t i = 0; i < size; i++) {
+        Base::emplace_back(value);
+    }
+}
+
+template<class T, class A, size_t K, class S>
+CCircularBufferExt<T, A, K, S>::CCircularBufferExt(const size_t capacity, CPow2Capacity): Base(inline_data(storage_), K, true) {
+    this->reserve(capacity);
+}
+
+// The base destructor only knows the layout of data_.
+template<class T, class A, size_t K, class S>
+CCircularBufferExt<T, A, K, S>::~CCircularBufferExt() {
+    settle();
 }
 
-template<class T, class A>
+template<class T, class A, size_t K, class S>
+CCircularBufferExt<T, A, K, S>& CCircularBufferExt<T, A, K, S>::operator=(const CCircularBufferExt& cont) {
+    if (this != &cont) {
+        CCircularBufferExt temp(cont);
+        *this = std::move(temp);
+    }
+    return *this;
+}
+
+template<class T, class A, size_t K, class S>
+CCircularBufferExt<T, A, K, S>& CCircularBufferExt<T, A, K, S>::operator=(CCircularBufferExt&& cont)
+        noexcept(std::is_nothrow_move_constructible_v<T>) {
+    if (this != &cont) {
+        this->clear();
+        this->release();
+        this->data_ = this->inline_;
+        take(cont);
+    }
+    return *this;
+}
+
+template<class T, class A, size_t K, class S>
+void CCircularBufferExt<T, A, K, S>::swap(CCircularBufferExt& cont) {
+    CCircularBufferExt temp(std::move(cont));
+    cont = std::move(*this);
+    *this = std::move(temp);
+}
+
+template<class T, class A, size_t K, class S>
+void swap(CCircularBufferExt<T, A, K, S>& a, CCircularBufferExt<T, A, K, S>& b) {
+    a.swap(b);
+}
+
+template<class T, class A, size_t K, class S>
+template<std::forward_iterator iter>
+void CCircularBufferExt<T, A, K, S>::assign(iter it1, iter it2) {
+    CCircularBufferExt temp(it1, it2);
+    replace(temp);
+}
+
+template<class T, class A, size_t K, class S>
+void CCircularBufferExt<T, A, K, S>::assign(std::initializer_list<T> il) {
+    CCircularBufferExt temp(il);
+    replace(temp);
+}
+
+template<class T, class A, size_t K, class S>
+void CCircularBufferExt<T, A, K, S>::assign(size_t n, const T& t) {
+    CCircularBufferExt temp(n, t);
+    replace(temp);
+}
+
+// The new contents are built in temp first, so the sources may refer to elements of this buffer.
+template<class T, class A, size_t K, class S>
+void CCircularBufferExt<T, A, K, S>::replace(CCircularBufferExt& temp) {
+    temp.full_ = this->full_;
+    *this = std::move(temp);
+}
+
+template<class T, class A, size_t K, class S>
+typename CCircularBufferExt<T, A, K, S>::Iterator CCircularBufferExt<T, A, K, S>::begin() {
+    return Iterator(this, 0);
+}
+
+template<class T, class A, size_t K, class S>
+typename CCircularBufferExt<T, A, K, S>::const_Iterator CCircularBufferExt<T, A, K, S>::begin() const {
+    return const_Iterator(this, 0);
+}
+
+template<class T, class A, size_t K, class S>
+typename CCircularBufferExt<T, A, K, S>::const_Iterator CCircularBufferExt<T, A, K, S>::cbegin() const {
+    return const_Iterator(this, 0);
+}
+
+template<class T, class A, size_t K, class S>
+typename CCircularBufferExt<T, A, K, S>::Iterator CCircularBufferExt<T, A, K, S>::end() {
+    return Iterator(this, this->size_);
+}
+
+template<class T, class A, size_t K, class S>
+typename CCircularBufferExt<T, A, K, S>::const_Iterator CCircularBufferExt<T, A, K, S>::end() const {
+    return const_Iterator(this, this->size_);
+}
+
+template<class T, class A, size_t K, class S>
+typename CCircularBufferExt<T, A, K, S>::const_Iterator CCircularBufferExt<T, A, K, S>::cend() const {
+    return const_Iterator(this, this->size_);
+}
+
+template<class T, class A, size_t K, class S>
+T& CCircularBufferExt<T, A, K, S>::front() {
+    return *slot(0);
+}
+
+template<class T, class A, size_t K, class S>
+const T& CCircularBufferExt<T, A, K, S>::front() const {
+    return *slot(0);
+}
+
+template<class T, class A, size_t K, class S>
+T& CCircularBufferExt<T, A, K, S>::back() {
+    return *slot(this->size_ - 1);
+}
+
+template<class T, class A, size_t K, class S>
+const T& CCircularBufferExt<T, A, K, S>::back() const {
+    return *slot(this->size_ - 1);
+}
+
+template<class T, class A, size_t K, class S>
+typename CCircularBufferExt<T, A, K, S>::reverse_iterator CCircularBufferExt<T, A, K, S>::rbegin() {
+    return reverse_iterator(end());
+}
+
+template<class T, class A, size_t K, class S>
+typename CCircularBufferExt<T, A, K, S>::const_reverse_iterator CCircularBufferExt<T, A, K, S>::rbegin() const {
+    return const_reverse_iterator(end());
+}
+
+template<class T, class A, size_t K, class S>
+typename CCircularBufferExt<T, A, K, S>::const_reverse_iterator CCircularBufferExt<T, A, K, S>::crbegin() const {
+    return const_reverse_iterator(cend());
+}
+
+template<class T, class A, size_t K, class S>
+typename CCircularBufferExt<T, A, K, S>::reverse_iterator CCircularBufferExt<T, A, K, S>::rend() {
+    return reverse_iterator(begin());
+}
+
+template<class T, class A, size_t K, class S>
+typename CCircularBufferExt<T, A, K, S>::const_reverse_iterator CCircularBufferExt<T, A, K, S>::rend() const {
+    return const_reverse_iterator(begin());
+}
+
+template<class T, class A, size_t K, class S>
+typename CCircularBufferExt<T, A, K, S>::const_reverse_iterator CCircularBufferExt<T, A, K, S>::crend() const {
+    return const_reverse_iterator(cbegin());
+}
+
+template<class T, class A, size_t K, class S>
+T& CCircularBufferExt<T, A, K, S>::operator[](size_type index) {
+    return *slot(index);
+}
+
+template<class T, class A, size_t K, class S>
+const T& CCircularBufferExt<T, A, K, S>::operator[](size_type index) const {
+    return *slot(index);
+}
+
+template<class T, class A, size_t K, class S>
+std::span<T> CCircularBufferExt<T, A, K, S>::array_one() {
+    settle();
+    return Base::array_one();
+}
+
+template<class T, class A, size_t K, class S>
+std::span<T> CCircularBufferExt<T, A, K, S>::array_two() {
+    settle();
+    return Base::array_two();
+}
+
+template<class T, class A, size_t K, class S>
+typename CCircularBufferExt<T, A, K, S>::Iterator CCircularBufferExt<T, A, K, S>::insert(Iterator it, const T& data) {
+    return emplace(it, data);
+}
+
+template<class T, class A, size_t K, class S>
+typename CCircularBufferExt<T, A, K, S>::Iterator CCircularBufferExt<T, A, K, S>::insert(Iterator it, T&& data) {
+    return emplace(it, std::move(data));
+}
+
+// While a migration is pending the value is built before it is finished, so arguments may still
+// refer to elements of the buffer.
+template<class T, class A, size_t K, class S>
+typename CCircularBufferExt<T, A, K, S>::Iterator CCircularBufferExt<T, A, K, S>::insert(Iterator it, size_t n, const T& data) {
+    if (old_ != nullptr) [[unlikely]] {
+        T value(data);
+        settle();
+        return own_iterator(Base::insert(base_iterator(it), n, value));
+    }
+    return own_iterator(Base::insert(base_iterator(it), n, data));
+}
+
+template<class T, class A, size_t K, class S>
+template<class... Args>
+typename CCircularBufferExt<T, A, K, S>::Iterator CCircularBufferExt<T, A, K, S>::emplace(Iterator it, Args&&... args) {
+    if (old_ != nullptr) [[unlikely]] {
+        T value(std::forward<Args>(args)...);
+        settle();
+        return own_iterator(Base::emplace(base_iterator(it), std::move(value)));
+    }
+    return own_iterator(Base::emplace(base_iterator(it), std::forward<Args>(args)...));
+}
+
+template<class T, class A, size_t K, class S>
 template<std::forward_iterator iter>
-CCircularBufferExt<T, A>::CCircularBufferExt(iter it1, iter it2):CCircularBuffer<T, A>(it1, it2) {
+typename CCircularBufferExt<T, A, K, S>::Iterator CCircularBufferExt<T, A, K, S>::insert(Iterator it, const iter& it1, const iter& it2) {
+    settle();
+    return own_iterator(Base::insert(base_iterator(it), it1, it2));
+}
+
+template<class T, class A, size_t K, class S>
+typename CCircularBufferExt<T, A, K, S>::Iterator CCircularBufferExt<T, A, K, S>::insert(Iterator it, std::initializer_list<T> list) {
+    return insert(it, list.begin(), list.end());
+}
+
+template<class T, class A, size_t K, class S>
+typename CCircularBufferExt<T, A, K, S>::Iterator CCircularBufferExt<T, A, K, S>::erase(Iterator it) {
+    settle();
+    return own_iterator(Base::erase(base_iterator(it)));
+}
+
+template<class T, class A, size_t K, class S>
+typename CCircularBufferExt<T, A, K, S>::const_Iterator CCircularBufferExt<T, A, K, S>::erase(const_Iterator it) {
+    erase(Iterator(this, it.index_));
+    return it;
+}
+
+template<class T, class A, size_t K, class S>
+typename CCircularBufferExt<T, A, K, S>::Iterator CCircularBufferExt<T, A, K, S>::erase(Iterator it1, Iterator it2) {
+    settle();
+    return own_iterator(Base::erase(base_iterator(it1), base_iterator(it2)));
+}
+
+template<class T, class A, size_t K, class S>
+typename CCircularBufferExt<T, A, K, S>::const_Iterator CCircularBufferExt<T, A, K, S>::erase(const_Iterator it1, const_Iterator it2) {
+    erase(Iterator(this, it1.index_), Iterator(this, it2.index_));
+    return it1;
+}
+
+template<class T, class A, size_t K, class S>
+template<class iter>
+size_t CCircularBufferExt<T, A, K, S>::copy_out(iter dest, size_t n) const {
+    if (old_ != nullptr) [[unlikely]] {
+        n = std::min(n, this->size_);
+        std::copy_n(begin(), n, dest);
+        return n;
+    }
+    return Base::copy_out(dest, n);
 }
 
-template<class T, class A>
-CCircularBufferExt<T, A>::CCircularBufferExt(){
+template<class T, class A, size_t K, class S>
+void CCircularBufferExt<T, A, K, S>::reserve(size_t newCapacity) {
+    settle();
+    Base::reserve(newCapacity);
+}
 
+template<class T, class A, size_t K, class S>
+void CCircularBufferExt<T, A, K, S>::resize(size_t newSize) {
+    settle();
+    Base::resize(newSize);
 }
 
-template<class T, class A>
-CCircularBufferExt<T, A>::CCircularBufferExt(const std::initializer_list<T> &il):CCircularBuffer<T, A>(il) {
+template<class T, class A, size_t K, class S>
+void CCircularBufferExt<T, A, K, S>::clear() {
+    settle();
+    Base::clear();
 }
 
-template<class T, class A>
-CCircularBufferExt<T, A>::CCircularBufferExt(const size_t size):CCircularBuffer<T, A>(size) {
+// Moves the contents of cont into this empty buffer. Inline elements are relocated into
+// this object's inline storage, heap blocks change owner; cont is left empty and inline.
+// The policies come along with the elements.
+template<class T, class A, size_t K, class S>
+void CCircularBufferExt<T, A, K, S>::take(CCircularBufferExt& cont) {
+    cont.settle();
+    this->pow2_ = cont.pow2_;
+    this->full_ = cont.full_;
+    shrink_ = cont.shrink_;
+    growStep_ = cont.growStep_;
+    lowOps_ = 0;
+    if (cont.is_inline()) {
+        cont.relocate(0, cont.size_, this->inline_);
+        this->data_ = this->inline_;
+        this->head_ = 0;
+    } else {
+        std::swap(this->alloc, cont.alloc);
+        this->data_ = cont.data_;
+        this->head_ = cont.head_;
+    }
+    this->size_ = cont.size_;
+    this->capacity_ = cont.capacity_;
+    this->mask_ = cont.mask_;
+    cont.data_ = cont.inline_;
+    cont.head_ = 0;
+    cont.size_ = 0;
+    cont.capacity_ = cont.inline_capacity();
+    cont.mask_ = cont.capacity_ - 1;
+    this->stats_.replaced(this->size_);
+    cont.stats_.replaced(0);
+}
+
+template<class T, class A, size_t K, class S>
+void CCircularBufferExt<T, A, K, S>::pop_front() {
+    if (this->size_ == 0) {
+        return;
+    }
+    std::destroy_at(this->slot(0));
+    this->head_ = this->wrap(this->head_ + 1);
+    this->size_--;
+    this->stats_.popped_front(1);
+    if (this->pending_ != 0) {
+        if (this->pendingFrom_ == 0) {
+            // the element came from the old block
+            this->oldHead_ = this->oldHead_ + 1 == this->oldCapacity_ ? 0 : this->oldHead_ + 1;
+            this->pending_--;
+        } else {
+            this->pendingFrom_--;
+        }
+    }
+    this->migrate(growStep_);
+    note_size();
+}
 
+template<class T, class A, size_t K, class S>
+void CCircularBufferExt<T, A, K, S>::pop_back() {
+    if (this->size_ == 0) {
+        return;
+    }
+    this->size_--;
+    std::destroy_at(this->slot(this->size_));
+    this->stats_.popped_back(1);
+    if (this->pending_ != 0 && this->pendingFrom_ + this->pending_ > this->size_) {
+        this->pending_--;
+    }
+    this->migrate(growStep_);
+    note_size();
 }
 
-template<class T, class A>
-CCircularBufferExt<T, A>::CCircularBufferExt(const size_t size, const T value):CCircularBuffer<T, A>(size, value) {
+template<class T, class A, size_t K, class S>
+void CCircularBufferExt<T, A, K, S>::pop_front(size_t n) {
+    settle();
+    Base::pop_front(n);
+    note_size();
+}
 
+template<class T, class A, size_t K, class S>
+void CCircularBufferExt<T, A, K, S>::pop_back(size_t n) {
+    settle();
+    Base::pop_back(n);
+    note_size();
 }
 
+template<class T, class A, size_t K, class S>
+void CCircularBufferExt<T, A, K, S>::set_incremental_growth(size_t step) {
+    if (step == 0) {
+        settle();
+    }
+    growStep_ = step;
+}
 
+template<class T, class A, size_t K, class S>
+size_t CCircularBufferExt<T, A, K, S>::incremental_growth() const {
+    return growStep_;
+}
+
+template<class T, class A, size_t K, class S>
+void CCircularBufferExt<T, A, K, S>::shrink_to_fit() {
+    settle();
+    this->reallocate(this->size_, false);
+    lowOps_ = 0;
+}
+
+template<class T, class A, size_t K, class S>
+void CCircularBufferExt<T, A, K, S>::set_shrink_policy(const CShrinkPolicy& policy) {
+    shrink_ = policy;
+    lowOps_ = 0;
+}
+
+template<class T, class A, size_t K, class S>
+const CShrinkPolicy& CCircularBufferExt<T, A, K, S>::shrink_policy() const {
+    return shrink_;
+}
+
+template<class T, class A, size_t K, class S>
+void CCircularBufferExt<T, A, K, S>::note_size() {
+    if (shrink_.patience == 0) {
+        return;
+    }
+    if (this->size_ * shrink_.lowWater > this->capacity_ || this->capacity_ <= shrink_.minCapacity) {
+        lowOps_ = 0;
+        return;
+    }
+    if (++lowOps_ >= shrink_.patience) {
+        lowOps_ = 0;
+        settle();
+        this->reallocate(std::max(this->capacity_ / 2, shrink_.minCapacity), false);
+    }
+}
+
+template<class T, class A, size_t K, class S>
+bool operator==(const CCircularBufferExt<T, A, K, S>& cont1, const CCircularBufferExt<T, A, K, S>& cont2) {
+    return (cont1.size() == cont2.size() && std::equal(cont1.begin(), cont1.end(), cont2.begin()));
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <compare>
+#include <iterator>
+#include <type_traits>
+
+// Random-access iterator shared by the rings that address their elements by logical index.
+// Iterators are (container, logical index) pairs: arithmetic, distance and comparison
+// are plain integer operations and only dereferencing asks the container, through its slot(i),
+// where element i lives. C befriends the iterator and reads index_ directly.
+template<class C, bool isConst>
+class CCircularBufferIterator {
+public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef std::random_access_iterator_tag iterator_concept;
+    typedef typename C::value_type value_type;
+    typedef typename C::difference_type difference_type;
+    typedef std::conditional_t<isConst, const value_type*, value_type*> pointer;
+    typedef std::conditional_t<isConst, const value_type&, value_type&> reference;
+    typedef std::conditional_t<isConst, const C*, C*> container_pointer;
+
+    friend C;
+    template<class, bool> friend class CCircularBufferIterator;
+
+    constexpr CCircularBufferIterator();
+    constexpr CCircularBufferIterator(container_pointer cont, difference_type index);
+    template<bool wasConst> requires (isConst && !wasConst)
+    constexpr CCircularBufferIterator(const CCircularBufferIterator<C, wasConst>& it);
+
+    constexpr reference operator*() const;
+    constexpr pointer operator->() const;
+    constexpr reference operator[](difference_type n) const;
+
+    constexpr CCircularBufferIterator& operator++();
+    constexpr CCircularBufferIterator operator++(int);
+    constexpr CCircularBufferIterator& operator--();
+    constexpr CCircularBufferIterator operator--(int);
+    constexpr CCircularBufferIterator& operator+=(difference_type n);
+    constexpr CCircularBufferIterator& operator-=(difference_type n);
+
+    constexpr CCircularBufferIterator operator+(difference_type n) const;
+    constexpr CCircularBufferIterator operator-(difference_type n) const;
+    template<bool otherConst>
+    constexpr difference_type operator-(const CCircularBufferIterator<C, otherConst>& other) const;
+
+    friend constexpr CCircularBufferIterator operator+(difference_type n, const CCircularBufferIterator& it) {
+        return it + n;
+    }
+
+    template<bool otherConst>
+    constexpr bool operator==(const CCircularBufferIterator<C, otherConst>& other) const;
+    template<bool otherConst>
+    constexpr std::strong_ordering operator<=>(const CCircularBufferIterator<C, otherConst>& other) const;
+
+protected:
+    container_pointer cont_;
+    difference_type index_;
+};
+
+template<class C, bool isConst>
+constexpr CCircularBufferIterator<C, isConst>::CCircularBufferIterator(): cont_(nullptr), index_(0) {}
+
+template<class C, bool isConst>
+constexpr CCircularBufferIterator<C, isConst>::CCircularBufferIterator(container_pointer cont, difference_type index):
+        cont_(cont), index_(index) {}
+
+template<class C, bool isConst>
+template<bool wasConst> requires (isConst && !wasConst)
+constexpr CCircularBufferIterator<C, isConst>::CCircularBufferIterator(const CCircularBufferIterator<C, wasConst>& it):
+        cont_(it.cont_), index_(it.index_) {}
+
+template<class C, bool isConst>
+constexpr typename CCircularBufferIterator<C, isConst>::reference CCircularBufferIterator<C, isConst>::operator*() const {
+    return *cont_->slot(index_);
+}
+
+template<class C, bool isConst>
+constexpr typename CCircularBufferIterator<C, isConst>::pointer CCircularBufferIterator<C, isConst>::operator->() const {
+    return cont_->slot(index_);
+}
+
+template<class C, bool isConst>
+constexpr typename CCircularBufferIterator<C, isConst>::reference CCircularBufferIterator<C, isConst>::operator[](difference_type n) const {
+    return *cont_->slot(index_ + n);
+}
+
+template<class C, bool isConst>
+constexpr CCircularBufferIterator<C, isConst>& CCircularBufferIterator<C, isConst>::operator++() {
+    index_++;
+    return *this;
+}
+
+template<class C, bool isConst>
+constexpr CCircularBufferIterator<C, isConst> CCircularBufferIterator<C, isConst>::operator++(int) {
+    CCircularBufferIterator temp(*this);
+    index_++;
+    return temp;
+}
+
+template<class C, bool isConst>
+constexpr CCircularBufferIterator<C, isConst>& CCircularBufferIterator<C, isConst>::operator--() {
+    index_--;
+    return *this;
+}
+
+template<class C, bool isConst>
+constexpr CCircularBufferIterator<C, isConst> CCircularBufferIterator<C, isConst>::operator--(int) {
+    CCircularBufferIterator temp(*this);
+    index_--;
+    return temp;
+}
+
+template<class C, bool isConst>
+constexpr CCircularBufferIterator<C, isConst>& CCircularBufferIterator<C, isConst>::operator+=(difference_type n) {
+    index_ += n;
+    return *this;
+}
+
+template<class C, bool isConst>
+constexpr CCircularBufferIterator<C, isConst>& CCircularBufferIterator<C, isConst>::operator-=(difference_type n) {
+    index_ -= n;
+    return *this;
+}
+
+template<class C, bool isConst>
+constexpr CCircularBufferIterator<C, isConst> CCircularBufferIterator<C, isConst>::operator+(difference_type n) const {
+    return CCircularBufferIterator(cont_, index_ + n);
+}
+
+template<class C, bool isConst>
+constexpr CCircularBufferIterator<C, isConst> CCircularBufferIterator<C, isConst>::operator-(difference_type n) const {
+    return CCircularBufferIterator(cont_, index_ - n);
+}
+
+template<class C, bool isConst>
+template<bool otherConst>
+constexpr typename CCircularBufferIterator<C, isConst>::difference_type CCircularBufferIterator<C, isConst>::operator-(
+        const CCircularBufferIterator<C, otherConst>& other) const {
+    return index_ - other.index_;
+}
+
+template<class C, bool isConst>
+template<bool otherConst>
+constexpr bool CCircularBufferIterator<C, isConst>::operator==(const CCircularBufferIterator<C, otherConst>& other) const {
+    return index_ == other.index_;
+}
+
+template<class C, bool isConst>
+template<bool otherConst>
+constexpr std::strong_ordering CCircularBufferIterator<C, isConst>::operator<=>(const CCircularBufferIterator<C, otherConst>& other) const {
+    return index_ <=> other.index_;
+}
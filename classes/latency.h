@@ -0,0 +1,293 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <memory>
+
+#include "stats.h"
+
+// Log-linear histogram of durations in nanoseconds, laid out like HdrHistogram: values below
+// 2^subBits have a bucket each and every higher power-of-two range is split into 2^subBits equal
+// buckets, so any value is reported within 1/32 of itself across the whole 64-bit range.
+// One thread records; counts are relaxed atomics, so other threads may read percentiles meanwhile.
+class CLatencyHistogram {
+public:
+    static constexpr unsigned subBits = 5;
+    static constexpr size_t subBuckets = size_t(1) << subBits;
+    static constexpr size_t bucketCount = (64 - subBits + 1) * subBuckets;
+
+    void record(uint64_t nanos);
+    void reset();
+
+    uint64_t count() const;
+    uint64_t min() const;
+    uint64_t max() const;
+    double mean() const;
+    // The smallest v such that at least p percent of the recorded values are <= v, rounded up to the
+    // top of v's bucket (but never above max()); 0 when nothing was recorded.
+    uint64_t percentile(double p) const;
+    // One "percentile\tnanoseconds" line for 50, 90, 99, 99.9, 99.99 and 100.
+    void print(std::ostream& out) const;
+
+    static size_t bucket(uint64_t nanos);
+    static uint64_t highest(size_t bucket);
+
+protected:
+    static void add(std::atomic<uint64_t>& counter, uint64_t n);
+
+    std::atomic<uint64_t> counts_[bucketCount];
+    std::atomic<uint64_t> total_ = 0;
+    std::atomic<uint64_t> sum_ = 0;
+    std::atomic<uint64_t> min_ = std::numeric_limits<uint64_t>::max();
+    std::atomic<uint64_t> max_ = 0;
+};
+
+// Statistics policy that adds residence times to the CAtomicStats counters: pushes stamp their elements
+// with steady_clock time and pops record how long each element stayed into latency().
+// The stamps live in a side ring that mirrors the order of the elements, so T's layout is untouched.
+// Elements that leave by being overwritten, erased or cleared are not recorded; elements that did not
+// arrive through a push, insert or emplace (construction from values, copies, swap) carry no stamp
+// and are not recorded either.
+class CLatencyStats : public CAtomicStats {
+public:
+    void pushed_back(size_t n, size_t size);
+    void pushed_front(size_t n, size_t size);
+    void inserted(size_t pos, size_t k, size_t size);
+    void popped_front(size_t n);
+    void popped_back(size_t n);
+    void erased(size_t pos, size_t k);
+    void replaced(size_t size);
+
+    const CLatencyHistogram& latency() const;
+    // Resets the counters and the histogram; elements already stored keep their stamps.
+    void reset();
+
+protected:
+    static constexpr uint64_t unstamped = 0;
+
+    static uint64_t now();
+    uint64_t& stamp(size_t i);
+    void reserve(size_t n);
+
+    std::unique_ptr<uint64_t[]> stamps_;
+    size_t head_ = 0;
+    size_t count_ = 0;
+    size_t capacity_ = 0;
+    CLatencyHistogram latency_;
+};
+
+inline void CLatencyHistogram::add(std::atomic<uint64_t>& counter, uint64_t n) {
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+inline size_t CLatencyHistogram::bucket(uint64_t nanos) {
+    if (nanos < subBuckets) {
+        return nanos;
+    }
+    unsigned shift = std::bit_width(nanos) - 1 - subBits;
+    return shift * subBuckets + (nanos >> shift);
+}
+
+inline uint64_t CLatencyHistogram::highest(size_t bucket) {
+    if (bucket < 2 * subBuckets) {
+        return bucket;
+    }
+    unsigned shift = bucket / subBuckets - 1;
+    uint64_t top = bucket - shift * subBuckets;
+    // wraps to the largest value for the last bucket
+    return ((top + 1) << shift) - 1;
+}
+
+inline void CLatencyHistogram::record(uint64_t nanos) {
+    add(counts_[bucket(nanos)], 1);
+    add(total_, 1);
+    add(sum_, nanos);
+    if (nanos < min_.load(std::memory_order_relaxed)) {
+        min_.store(nanos, std::memory_order_relaxed);
+    }
+    if (nanos > max_.load(std::memory_order_relaxed)) {
+        max_.store(nanos, std::memory_order_relaxed);
+    }
+}
+
+inline void CLatencyHistogram::reset() {
+    for (std::atomic<uint64_t>& counter : counts_) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+    total_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    min_.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+inline uint64_t CLatencyHistogram::count() const {
+    return total_.load(std::memory_order_relaxed);
+}
+
+inline uint64_t CLatencyHistogram::min() const {
+    return count() == 0 ? 0 : min_.load(std::memory_order_relaxed);
+}
+
+inline uint64_t CLatencyHistogram::max() const {
+    return max_.load(std::memory_order_relaxed);
+}
+
+inline double CLatencyHistogram::mean() const {
+    uint64_t total = count();
+    return total == 0 ? 0 : double(sum_.load(std::memory_order_relaxed)) / total;
+}
+
+// The buckets are summed first rather than trusting total_, so that a concurrent record()
+// cannot make the rank unreachable.
+inline uint64_t CLatencyHistogram::percentile(double p) const {
+    uint64_t total = 0;
+    for (const std::atomic<uint64_t>& counter : counts_) {
+        total += counter.load(std::memory_order_relaxed);
+    }
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = std::clamp<uint64_t>(std::ceil(std::clamp(p, 0.0, 100.0) / 100 * total), 1, total);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < bucketCount; i++) {
+        seen += counts_[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            return std::min(highest(i), max());
+        }
+    }
+    return max();
+}
+
+inline void CLatencyHistogram::print(std::ostream& out) const {
+    for (double p : {50.0, 90.0, 99.0, 99.9, 99.99, 100.0}) {
+        out << p << '\t' << percentile(p) << '\n';
+    }
+}
+
+inline uint64_t CLatencyStats::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline uint64_t& CLatencyStats::stamp(size_t i) {
+    return stamps_[(head_ + i) & (capacity_ - 1)];
+}
+
+// Makes room for n stamps; the ring's capacity is a power of two.
+inline void CLatencyStats::reserve(size_t n) {
+    if (n <= capacity_) {
+        return;
+    }
+    size_t newCapacity = std::bit_ceil(std::max<size_t>(n, 16));
+    std::unique_ptr<uint64_t[]> stamps(new uint64_t[newCapacity]);
+    for (size_t i = 0; i < count_; i++) {
+        stamps[i] = stamp(i);
+    }
+    stamps_ = std::move(stamps);
+    capacity_ = newCapacity;
+    head_ = 0;
+}
+
+// Stamps of overwritten elements are dropped from the opposite end first.
+inline void CLatencyStats::pushed_back(size_t n, size_t size) {
+    CAtomicStats::pushed_back(n, size);
+    if (count_ + n > size) {
+        size_t overwritten = count_ + n - size;
+        head_ = (head_ + overwritten) & (capacity_ - 1);
+        count_ -= overwritten;
+    }
+    reserve(count_ + n);
+    uint64_t time = now();
+    for (size_t i = 0; i < n; i++) {
+        stamp(count_ + i) = time;
+    }
+    count_ += n;
+}
+
+inline void CLatencyStats::pushed_front(size_t n, size_t size) {
+    CAtomicStats::pushed_front(n, size);
+    if (count_ + n > size) {
+        count_ = size - n;
+    }
+    reserve(count_ + n);
+    head_ = (head_ - n) & (capacity_ - 1);
+    count_ += n;
+    uint64_t time = now();
+    for (size_t i = 0; i < n; i++) {
+        stamp(i) = time;
+    }
+}
+
+inline void CLatencyStats::inserted(size_t pos, size_t k, size_t size) {
+    CAtomicStats::inserted(pos, k, size);
+    if (count_ + k > size) {
+        size_t overwritten = count_ + k - size;
+        head_ = (head_ + overwritten) & (capacity_ - 1);
+        count_ -= overwritten;
+    }
+    reserve(count_ + k);
+    for (size_t i = count_; i-- > pos;) {
+        stamp(i + k) = stamp(i);
+    }
+    uint64_t time = now();
+    for (size_t i = pos; i < pos + k; i++) {
+        stamp(i) = time;
+    }
+    count_ += k;
+}
+
+inline void CLatencyStats::popped_front(size_t n) {
+    CAtomicStats::popped_front(n);
+    uint64_t time = now();
+    for (size_t i = 0; i < n; i++) {
+        if (stamp(i) != unstamped) {
+            latency_.record(time - stamp(i));
+        }
+    }
+    head_ = (head_ + n) & (capacity_ - 1);
+    count_ -= n;
+}
+
+inline void CLatencyStats::popped_back(size_t n) {
+    CAtomicStats::popped_back(n);
+    uint64_t time = now();
+    for (size_t i = count_ - n; i < count_; i++) {
+        if (stamp(i) != unstamped) {
+            latency_.record(time - stamp(i));
+        }
+    }
+    count_ -= n;
+}
+
+inline void CLatencyStats::erased(size_t pos, size_t k) {
+    CAtomicStats::erased(pos, k);
+    for (size_t i = pos + k; i < count_; i++) {
+        stamp(i - k) = stamp(i);
+    }
+    count_ -= k;
+}
+
+inline void CLatencyStats::replaced(size_t size) {
+    CAtomicStats::replaced(size);
+    count_ = 0;
+    reserve(size);
+    for (size_t i = 0; i < size; i++) {
+        stamp(i) = unstamped;
+    }
+    count_ = size;
+}
+
+inline const CLatencyHistogram& CLatencyStats::latency() const {
+    return latency_;
+}
+
+inline void CLatencyStats::reset() {
+    CAtomicStats::reset();
+    latency_.reset();
+}
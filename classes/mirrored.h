@@ -0,0 +1,320 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <numeric>
+#include <span>
+#include <system_error>
+#include <type_traits>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Ring whose storage is one memfd mapped twice, back to back: data_[i] and data_[i + capacity_]
+// are the same memory. Any run of up to capacity() elements starting at the head is therefore
+// a plain contiguous range, so iterators are raw pointers and spans never split at the wrap point.
+// Capacity is rounded up so that the storage is a whole number of pages. Linux only.
+template<class T>
+class CCircularBufferMirrored {
+    static_assert(std::is_trivially_copyable_v<T>, "mirrored storage copies elements as raw bytes");
+
+public:
+    typedef ptrdiff_t difference_type;
+    typedef size_t size_type;
+    typedef T value_type;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef T* iterator;
+    typedef const T* const_iterator;
+
+    CCircularBufferMirrored(const size_t capacity);
+    CCircularBufferMirrored(const CCircularBufferMirrored&) = delete;
+    CCircularBufferMirrored(CCircularBufferMirrored&& cont) noexcept;
+    CCircularBufferMirrored& operator=(const CCircularBufferMirrored&) = delete;
+    CCircularBufferMirrored& operator=(CCircularBufferMirrored&& cont) noexcept;
+
+    ~CCircularBufferMirrored();
+
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+    T* data();
+    const T* data() const;
+    std::span<T> span();
+    std::span<const T> span() const;
+
+    T& operator[](size_t i);
+    const T& operator[](size_t i) const;
+    T& front();
+    T& back();
+    const T& front() const;
+    const T& back() const;
+
+    // Full buffers overwrite the opposite end, as CCircularBuffer does.
+    void push_back(const T& elem);
+    void push_front(const T& elem);
+    void push_back(const T* src, size_t n);
+    void pop_front();
+    void pop_back();
+    void pop_front(size_t n);
+    void pop_back(size_t n);
+
+    // Contiguous free space after the last element; fill it in place and then commit(n).
+    std::span<T> write_span();
+    void commit(size_t n);
+
+    void clear();
+    bool empty() const;
+    size_type size() const;
+    size_type capacity() const;
+    void swap(CCircularBufferMirrored& cont) noexcept;
+
+protected:
+    size_t wrap(size_t i) const;
+
+    T* data_;
+    size_t head_;
+    size_t size_;
+    size_t capacity_;
+};
+
+template<class T>
+CCircularBufferMirrored<T>::CCircularBufferMirrored(const size_t capacity): head_(0), size_(0) {
+    size_t unit = std::lcm((size_t) sysconf(_SC_PAGESIZE), sizeof(T));
+    size_t bytes = std::max<size_t>((capacity * sizeof(T) + unit - 1) / unit, 1) * unit;
+    capacity_ = bytes / sizeof(T);
+
+    int fd = memfd_create("CCircularBufferMirrored", MFD_CLOEXEC);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "memfd_create");
+    }
+    if (ftruncate(fd, bytes) != 0) {
+        int error = errno;
+        close(fd);
+        throw std::system_error(error, std::generic_category(), "ftruncate");
+    }
+    // reserve both halves first so that nothing else can be mapped in between
+    void* base = mmap(nullptr, 2 * bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        int error = errno;
+        close(fd);
+        throw std::system_error(error, std::generic_category(), "mmap");
+    }
+    char* first = static_cast<char*>(base);
+    if (mmap(first, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+        mmap(first + bytes, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        int error = errno;
+        munmap(base, 2 * bytes);
+        close(fd);
+        throw std::system_error(error, std::generic_category(), "mmap");
+    }
+    close(fd);
+    data_ = reinterpret_cast<T*>(first);
+}
+
+template<class T>
+CCircularBufferMirrored<T>::CCircularBufferMirrored(CCircularBufferMirrored&& cont) noexcept: data_(cont.data_),
+        head_(cont.head_), size_(cont.size_), capacity_(cont.capacity_) {
+    cont.data_ = nullptr;
+    cont.head_ = 0;
+    cont.size_ = 0;
+    cont.capacity_ = 0;
+}
+
+template<class T>
+CCircularBufferMirrored<T>& CCircularBufferMirrored<T>::operator=(CCircularBufferMirrored&& cont) noexcept {
+    swap(cont);
+    return *this;
+}
+
+template<class T>
+CCircularBufferMirrored<T>::~CCircularBufferMirrored() {
+    if (data_ != nullptr) {
+        munmap(data_, 2 * capacity_ * sizeof(T));
+    }
+}
+
+template<class T>
+size_t CCircularBufferMirrored<T>::wrap(size_t i) const {
+    return i < capacity_ ? i : i - capacity_;
+}
+
+template<class T>
+typename CCircularBufferMirrored<T>::iterator CCircularBufferMirrored<T>::begin() {
+    return data_ + head_;
+}
+
+template<class T>
+typename CCircularBufferMirrored<T>::iterator CCircularBufferMirrored<T>::end() {
+    return data_ + head_ + size_;
+}
+
+template<class T>
+typename CCircularBufferMirrored<T>::const_iterator CCircularBufferMirrored<T>::begin() const {
+    return data_ + head_;
+}
+
+template<class T>
+typename CCircularBufferMirrored<T>::const_iterator CCircularBufferMirrored<T>::end() const {
+    return data_ + head_ + size_;
+}
+
+template<class T>
+T* CCircularBufferMirrored<T>::data() {
+    return data_ + head_;
+}
+
+template<class T>
+const T* CCircularBufferMirrored<T>::data() const {
+    return data_ + head_;
+}
+
+template<class T>
+std::span<T> CCircularBufferMirrored<T>::span() {
+    return {data_ + head_, size_};
+}
+
+template<class T>
+std::span<const T> CCircularBufferMirrored<T>::span() const {
+    return {data_ + head_, size_};
+}
+
+template<class T>
+T& CCircularBufferMirrored<T>::operator[](size_t i) {
+    return data_[head_ + i];
+}
+
+template<class T>
+const T& CCircularBufferMirrored<T>::operator[](size_t i) const {
+    return data_[head_ + i];
+}
+
+template<class T>
+T& CCircularBufferMirrored<T>::front() {
+    return data_[head_];
+}
+
+template<class T>
+T& CCircularBufferMirrored<T>::back() {
+    return data_[head_ + size_ - 1];
+}
+
+template<class T>
+const T& CCircularBufferMirrored<T>::front() const {
+    return data_[head_];
+}
+
+template<class T>
+const T& CCircularBufferMirrored<T>::back() const {
+    return data_[head_ + size_ - 1];
+}
+
+template<class T>
+void CCircularBufferMirrored<T>::push_back(const T& elem) {
+    data_[head_ + size_] = elem;
+    if (size_ == capacity_) {
+        head_ = wrap(head_ + 1);
+    } else {
+        size_++;
+    }
+}
+
+template<class T>
+void CCircularBufferMirrored<T>::push_front(const T& elem) {
+    head_ = wrap(head_ + capacity_ - 1);
+    data_[head_] = elem;
+    if (size_ != capacity_) {
+        size_++;
+    }
+}
+
+// Keeps only the last capacity() elements when the range does not fit.
+template<class T>
+void CCircularBufferMirrored<T>::push_back(const T* src, size_t n) {
+    if (n >= capacity_) {
+        std::memcpy(data_, src + n - capacity_, capacity_ * sizeof(T));
+        head_ = 0;
+        size_ = capacity_;
+        return;
+    }
+    if (n == 0) {
+        return;
+    }
+    std::memcpy(data_ + wrap(head_ + size_), src, n * sizeof(T));
+    if (size_ + n > capacity_) {
+        head_ = wrap(head_ + size_ + n - capacity_);
+        size_ = capacity_;
+    } else {
+        size_ += n;
+    }
+}
+
+template<class T>
+void CCircularBufferMirrored<T>::pop_front() {
+    if (size_ == 0) {
+        return;
+    }
+    head_ = wrap(head_ + 1);
+    size_--;
+}
+
+template<class T>
+void CCircularBufferMirrored<T>::pop_back() {
+    if (size_ == 0) {
+        return;
+    }
+    size_--;
+}
+
+template<class T>
+void CCircularBufferMirrored<T>::pop_front(size_t n) {
+    n = std::min(n, size_);
+    head_ = wrap(head_ + n);
+    size_ -= n;
+}
+
+template<class T>
+void CCircularBufferMirrored<T>::pop_back(size_t n) {
+    size_ -= std::min(n, size_);
+}
+
+template<class T>
+std::span<T> CCircularBufferMirrored<T>::write_span() {
+    return {data_ + head_ + size_, capacity_ - size_};
+}
+
+template<class T>
+void CCircularBufferMirrored<T>::commit(size_t n) {
+    size_ += std::min(n, capacity_ - size_);
+}
+
+template<class T>
+void CCircularBufferMirrored<T>::clear() {
+    head_ = 0;
+    size_ = 0;
+}
+
+template<class T>
+bool CCircularBufferMirrored<T>::empty() const {
+    return size_ == 0;
+}
+
+template<class T>
+typename CCircularBufferMirrored<T>::size_type CCircularBufferMirrored<T>::size() const {
+    return size_;
+}
+
+template<class T>
+typename CCircularBufferMirrored<T>::size_type CCircularBufferMirrored<T>::capacity() const {
+    return capacity_;
+}
+
+template<class T>
+void CCircularBufferMirrored<T>::swap(CCircularBufferMirrored& cont) noexcept {
+    std::swap(data_, cont.data_);
+    std::swap(head_, cont.head_);
+    std::swap(size_, cont.size_);
+    std::swap(capacity_, cont.capacity_);
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <iterator>
+
+// Bounded lock-free ring for any number of producers and consumers.
+// Every slot carries a sequence number: slot i is free for the producer of position pos
+// when seq == pos and holds data for the consumer of pos when seq == pos + 1.
+// Capacity is rounded up to a power of two so positions map to slots with a mask, and to at
+// least two slots: with one, "free for pos + 1" and "full for pos" would be the same seq.
+template<class T, class A = std::allocator<T>>
+class CCircularBufferMPMC {
+public:
+    typedef typename A::size_type size_type;
+
+    CCircularBufferMPMC(const size_t capacity);
+    CCircularBufferMPMC(const CCircularBufferMPMC&) = delete;
+    CCircularBufferMPMC& operator=(const CCircularBufferMPMC&) = delete;
+
+    ~CCircularBufferMPMC();
+
+    bool try_push(const T& value);
+    template<class... Args>
+    bool try_emplace(Args&&... args);
+    bool try_pop(T& value);
+
+    template<std::forward_iterator iter>
+    size_t try_push(iter it1, iter it2);
+    template<std::output_iterator<T> iter>
+    size_t try_pop(iter out, size_t n);
+
+    size_type size() const;
+    size_type capacity() const;
+    bool empty() const;
+
+protected:
+    static constexpr size_t cacheLine = 64;
+
+    struct Slot {
+        std::atomic<size_t> seq;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* value() {
+            return reinterpret_cast<T*>(storage);
+        }
+    };
+
+    typedef typename std::allocator_traits<A>::template rebind_alloc<Slot> SlotAlloc;
+
+    size_t claim_push(size_t& pos, size_t n);
+    size_t claim_pop(size_t& pos, size_t n);
+
+    SlotAlloc alloc;
+    Slot* slots_;
+    size_t capacity_;
+    size_t mask_;
+
+    alignas(cacheLine) std::atomic<size_t> tail_;
+    alignas(cacheLine) std::atomic<size_t> head_;
+};
+
+template<class T, class A>
+CCircularBufferMPMC<T, A>::CCircularBufferMPMC(const size_t capacity): tail_(0), head_(0) {
+    capacity_ = 2;
+    while (capacity_ < capacity) {
+        capacity_ *= 2;
+    }
+    mask_ = capacity_ - 1;
+    slots_ = alloc.allocate(capacity_);
+    for (size_t i = 0; i < capacity_; i++) {
+        std::construct_at(&slots_[i].seq, i);
+    }
+}
+
+template<class T, class A>
+CCircularBufferMPMC<T, A>::~CCircularBufferMPMC() {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    for (; head != tail; head++) {
+        std::destroy_at(slots_[head & mask_].value());
+    }
+    for (size_t i = 0; i < capacity_; i++) {
+        std::destroy_at(&slots_[i].seq);
+    }
+    alloc.deallocate(slots_, capacity_);
+}
+
+// Reserves up to n consecutive free slots starting at pos with a single CAS on tail_.
+template<class T, class A>
+size_t CCircularBufferMPMC<T, A>::claim_push(size_t& pos, size_t n) {
+    pos = tail_.load(std::memory_order_relaxed);
+    if (n == 0) {
+        return 0;
+    }
+    while (true) {
+        size_t k = 0;
+        while (k < n && slots_[(pos + k) & mask_].seq.load(std::memory_order_acquire) == pos + k) {
+            k++;
+        }
+        if (k == 0) {
+            size_t seq = slots_[pos & mask_].seq.load(std::memory_order_acquire);
+            if ((ptrdiff_t) (seq - pos) < 0) {
+                return 0;
+            }
+            pos = tail_.load(std::memory_order_relaxed);
+            continue;
+        }
+        if (tail_.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed)) {
+            return k;
+        }
+    }
+}
+
+// Reserves up to n consecutive filled slots starting at pos with a single CAS on head_.
+template<class T, class A>
+size_t CCircularBufferMPMC<T, A>::claim_pop(size_t& pos, size_t n) {
+    pos = head_.load(std::memory_order_relaxed);
+    if (n == 0) {
+        return 0;
+    }
+    while (true) {
+        size_t k = 0;
+        while (k < n && slots_[(pos + k) & mask_].seq.load(std::memory_order_acquire) == pos + k + 1) {
+            k++;
+        }
+        if (k == 0) {
+            size_t seq = slots_[pos & mask_].seq.load(std::memory_order_acquire);
+            if ((ptrdiff_t) (seq - (pos + 1)) < 0) {
+                return 0;
+            }
+            pos = head_.load(std::memory_order_relaxed);
+            continue;
+        }
+        if (head_.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed)) {
+            return k;
+        }
+    }
+}
+
+template<class T, class A>
+bool CCircularBufferMPMC<T, A>::try_push(const T& value) {
+    return try_emplace(value);
+}
+
+template<class T, class A>
+template<class... Args>
+bool CCircularBufferMPMC<T, A>::try_emplace(Args&&... args) {
+    size_t pos;
+    if (claim_push(pos, 1) == 0) {
+        return false;
+    }
+    Slot& slot = slots_[pos & mask_];
+    std::construct_at(slot.value(), std::forward<Args>(args)...);
+    slot.seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+template<class T, class A>
+bool CCircularBufferMPMC<T, A>::try_pop(T& value) {
+    size_t pos;
+    if (claim_pop(pos, 1) == 0) {
+        return false;
+    }
+    Slot& slot = slots_[pos & mask_];
+    value = std::move(*slot.value());
+    std::destroy_at(slot.value());
+    slot.seq.store(pos + capacity_, std::memory_order_release);
+    return true;
+}
+
+template<class T, class A>
+template<std::forward_iterator iter>
+size_t CCircularBufferMPMC<T, A>::try_push(iter it1, iter it2) {
+    size_t pos;
+    size_t n = claim_push(pos, std::distance(it1, it2));
+    for (size_t i = 0; i < n; i++, it1++) {
+        Slot& slot = slots_[(pos + i) & mask_];
+        std::construct_at(slot.value(), *it1);
+        slot.seq.store(pos + i + 1, std::memory_order_release);
+    }
+    return n;
+}
+
+template<class T, class A>
+template<std::output_iterator<T> iter>
+size_t CCircularBufferMPMC<T, A>::try_pop(iter out, size_t n) {
+    size_t pos;
+    n = claim_pop(pos, n);
+    for (size_t i = 0; i < n; i++, out++) {
+        Slot& slot = slots_[(pos + i) & mask_];
+        *out = std::move(*slot.value());
+        std::destroy_at(slot.value());
+        slot.seq.store(pos + i + capacity_, std::memory_order_release);
+    }
+    return n;
+}
+
+template<class T, class A>
+typename CCircularBufferMPMC<T, A>::size_type CCircularBufferMPMC<T, A>::size() const {
+    size_t head = head_.load(std::memory_order_acquire);
+    size_t tail = tail_.load(std::memory_order_acquire);
+    return (ptrdiff_t) (tail - head) > 0 ? tail - head : 0;
+}
+
+template<class T, class A>
+typename CCircularBufferMPMC<T, A>::size_type CCircularBufferMPMC<T, A>::capacity() const {
+    return capacity_;
+}
+
+template<class T, class A>
+bool CCircularBufferMPMC<T, A>::empty() const {
+    return size() == 0;
+}
@@ -1,131 +1,115 @@
 #pragma once
 
+#include <algorithm>
+#include <bit>
+#include <compare>
+#include <cstring>
 #include <iostream>
+#include <iterator>
 #include <memory>
 #include <limits>
+#include <span>
+#include <type_traits>
+
+#include "iterator.h"
+#include "stats.h"
+
+// Selects the power-of-two capacity mode: capacity is rounded up to a power of two
+// and every index wraps with a mask instead of a compare.
+struct CPow2Capacity {};
+inline constexpr CPow2Capacity pow2Capacity {};
+
+// Types whose objects may be moved to new storage with memcpy, skipping the destructor of the source.
+// Trivially copyable types qualify; specialize for other types that are safe to relocate bitwise.
+template<class T>
+struct CTriviallyRelocatable : std::is_trivially_copyable<T> {};
+
+// What a push into a full buffer does: overwrite the element at the opposite end (the default
+// for CCircularBuffer), drop the new element, or grow the capacity (the default for CCircularBufferExt).
+// insert and emplace follow the policy too. Under Overwrite a full buffer keeps the newest capacity()
+// elements of the sequence with the insertion, so the oldest ones make room; an insertion at the front
+// is itself among the oldest and is only partly stored, or not at all. Under Reject an insertion that
+// does not fit is dropped as a whole. They return end() when nothing was stored.
+enum class CFullPolicy {
+    Overwrite,
+    Reject,
+    Grow
+};
 
-template<class T, class A = std::allocator<T>>
+// S is the statistics policy behind stats() (see stats.h); the default CNoStats keeps none.
+template<class T, class A = std::allocator<T>, class S = CNoStats>
 class CCircularBuffer {
 public:
     typedef typename A::difference_type difference_type;
     typedef typename A::size_type size_type;
 
-    class Iterator: public std::iterator<std::random_access_iterator_tag, T> {
-    public:
-        friend class CCircularBuffer<T, A>;
-        Iterator(T* p, CCircularBuffer<T, A>* cont, bool isbeg = false, bool isend = false);
-        Iterator(const Iterator& it);
-
-        difference_type operator-(const typename CCircularBuffer<T, A>::Iterator other);
-        Iterator operator+(const difference_type n);
-        Iterator operator-(const difference_type n);
-
-        Iterator& operator++();
-        Iterator operator++(int);
-        Iterator& operator--();
-        Iterator operator--(int);
-        Iterator& operator+=(const difference_type);
-        Iterator& operator-=(const difference_type);
-
-        bool operator==(const Iterator& other) const;
-        bool operator!=(const Iterator & other) const;
-        bool operator<(const Iterator& it) const;
-        bool operator>(const Iterator& it) const;
-        bool operator>=(const Iterator& it) const;
-        bool operator<=(const Iterator& it) const;
-
-        typename Iterator::pointer operator->() const;
-        typename Iterator::reference operator*() const;
-
-
-    protected:
-        T* add(T* p, difference_type n) const;
-        T* sub(T* p, difference_type n) const;
-
-        T* linearize() const;
-
-        T* point;
-        CCircularBuffer<T, A>* cont_;
-
-        bool isBegin = false;
-        bool isEnd = false;
-    };
-
-    class const_Iterator: public std::iterator<std::random_access_iterator_tag, T> {
-    public:
-        friend class CCircularBuffer<T, A>;
-        const_Iterator(T* p, const CCircularBuffer<T, A>* cont, bool isbeg = false, bool isend = false);
-        const_Iterator(const const_Iterator& it);
-        const_Iterator(const Iterator& it);
-
-        const_Iterator& operator++();
-        const_Iterator operator++(int);
-        const_Iterator& operator--();
-        const_Iterator operator--(int);
-        const_Iterator& operator+=(const difference_type);
-        const_Iterator& operator-=(const difference_type);
-
-        difference_type operator-(const typename CCircularBuffer<T, A>::const_Iterator& other);
-        const_Iterator operator+(const difference_type n);
-        const_Iterator operator-(const difference_type n);
-
+    typedef T value_type;
+    typedef T& reference;
+    typedef const T& const_reference;
 
-        bool operator==(const const_Iterator& other) const;
-        bool operator!=(const const_Iterator& other) const;
-        bool operator<(const const_Iterator& it) const;
-        bool operator>(const const_Iterator& it) const;
-        bool operator>=(const const_Iterator& it) const;
-        bool operator<=(const const_Iterator& it) const;
+    // Iterators are (container, logical index) pairs: arithmetic, distance and comparison
+    // are plain integer operations and only dereferencing maps the index onto data_.
+    template<bool isConst>
+    using BaseIterator = CCircularBufferIterator<CCircularBuffer, isConst>;
+    template<class, bool> friend class CCircularBufferIterator;
 
-
-        const typename const_Iterator::pointer operator->() const;
-
-        const typename const_Iterator::reference operator*();
-
-
-    protected:
-        typename const_Iterator::reference operator*() const;
-        T* add(T* p, difference_type n) const;
-        T* sub(T* p, difference_type n) const;
-
-        T* linearize() const;
-
-        T* point;
-        const CCircularBuffer<T, A>* cont_;
-
-        bool isBegin = false;
-        bool isEnd = false;
-    };
+    typedef BaseIterator<false> Iterator;
+    typedef BaseIterator<true> const_Iterator;
+    typedef Iterator iterator;
+    typedef const_Iterator const_iterator;
+    typedef std::reverse_iterator<Iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_Iterator> const_reverse_iterator;
 
     template<std::forward_iterator iter>
     CCircularBuffer(iter it1, iter it2);
     CCircularBuffer(const std::initializer_list<T> &);
     CCircularBuffer(const CCircularBuffer &);
+    CCircularBuffer(CCircularBuffer &&) noexcept;
     CCircularBuffer();
     CCircularBuffer(const size_t size);
-    CCircularBuffer(const size_t size, const T value);
+    CCircularBuffer(const size_t size, const T& value);
+    CCircularBuffer(const size_t capacity, CPow2Capacity);
 
     ~CCircularBuffer();
 
+    CCircularBuffer& operator=(const CCircularBuffer &);
+    CCircularBuffer& operator=(CCircularBuffer &&) noexcept;
+
 
     Iterator begin();
-    Iterator begin() const;
+    const_Iterator begin() const;
     const_Iterator cbegin() const;
     T& front();
     const T& front() const;
     Iterator end();
-    Iterator end() const;
+    const_Iterator end() const;
     const_Iterator cend() const;
     T& back();
     const T& back() const;
 
+    reverse_iterator rbegin();
+    const_reverse_iterator rbegin() const;
+    const_reverse_iterator crbegin() const;
+    reverse_iterator rend();
+    const_reverse_iterator rend() const;
+    const_reverse_iterator crend() const;
+
     T& operator[](size_type index);
     const T& operator[](size_type index) const;
 
+    // The stored elements always occupy at most two contiguous runs of data_:
+    // array_one() starts at front() and array_two() holds the part that wrapped to data_.
+    std::span<T> array_one();
+    std::span<T> array_two();
+    std::span<const T> array_one() const;
+    std::span<const T> array_two() const;
 
 
-    Iterator insert(Iterator it, const T data);
-    Iterator insert(Iterator it, size_t n, const T data);
+    Iterator insert(Iterator it, const T& data);
+    Iterator insert(Iterator it, T&& data);
+    Iterator insert(Iterator it, size_t n, const T& data);
+    template<class... Args>
+    Iterator emplace(Iterator it, Args&&... args);
 
     template<std::forward_iterator iter>
     Iterator insert(Iterator it, const iter& it1, const iter& it2);
@@ -137,19 +121,51 @@ public:
     const_Iterator erase(const_Iterator it1, const_Iterator it2);
 
 
-    virtual void push_front(const T& value);
+    void push_front(const T& value);
+    void push_front(T&& value);
+    template<class... Args>
+    void emplace_front(Args&&... args);
     void pop_front();
 
-    virtual void push_back(const T& elem);
+    void push_back(const T& elem);
+    void push_back(T&& elem);
+    template<class... Args>
+    void emplace_back(Args&&... args);
     void pop_back();
 
+    // Return false when the value was dropped, i.e. the buffer is full under CFullPolicy::Reject
+    // (or has no capacity at all); otherwise they behave exactly like push_* and emplace_*.
+    bool try_push_front(const T& value);
+    bool try_push_front(T&& value);
+    template<class... Args>
+    bool try_emplace_front(Args&&... args);
+    bool try_push_back(const T& elem);
+    bool try_push_back(T&& elem);
+    template<class... Args>
+    bool try_emplace_back(Args&&... args);
+
+    // Bulk versions split the work at the wrap point; for trivially copyable T and
+    // contiguous sources every copy is at most two memcpy calls.
+    // Like the single-element versions they follow the full-buffer policy: under Overwrite
+    // they overwrite the oldest (push_back) or the newest (push_front) elements, under Reject
+    // only the part of the range nearest to the stored elements is kept.
+    // push_front places [it1, it2) before front() keeping the order of the range.
+    template<std::forward_iterator iter>
+    void push_back(iter it1, iter it2);
+    template<std::forward_iterator iter>
+    void push_front(iter it1, iter it2);
+    void pop_front(size_t n);
+    void pop_back(size_t n);
+    template<class iter>
+    size_t copy_out(iter dest, size_t n) const;
+
     void reserve(size_t newCapacity);
     void resize(size_t newSize);
 
     template<std::forward_iterator iter>
     void assign(iter it1, iter it2);
     void assign(std::initializer_list<T> il);
-    void assign(size_t n, T t);
+    void assign(size_t n, const T& t);
     void clear();
     bool empty() const;
     size_type size() const;
@@ -158,563 +174,618 @@ public:
     void swap(CCircularBuffer &);
     size_type max_size() const;
 
+    void set_full_policy(CFullPolicy policy);
+    CFullPolicy full_policy() const;
+    // Elements lost to a full buffer since construction or reset_counters(): overwritten()
+    // counts stored elements replaced under Overwrite, dropped() counts new ones turned away.
+    size_type overwritten() const;
+    size_type dropped() const;
+    void reset_counters();
+    // Counters kept by the statistics policy S since construction or reset_counters(); all zero
+    // under the default CNoStats. Safe to call from another thread while the owner modifies the buffer.
+    CBufferStats stats() const;
+    // The policy itself, for what it records beyond the counters (e.g. CLatencyStats::latency()).
+    const S& stats_policy() const;
+
 protected:
+    template<class iter>
+    static iter construct_run(T* dest, iter src, size_t n);
+    template<class iter>
+    static iter copy_run(const T* src, iter dest, size_t n);
+
+    size_t wrap(size_t i) const;
+    T* slot(size_t i) const;
+    void open_gap(size_t pos, size_t k);
+    size_t admit(size_t& pos, size_t k);
+    T* allocate(size_t& n, bool atLeast);
+    void relocate(size_t from, size_t n, T* dest);
+    void reallocate(size_t newCapacity, bool atLeast);
+
+    CCircularBuffer(T* inlineData, size_t inlineCapacity, bool pow2);
+    bool is_inline() const;
+    size_t inline_capacity() const;
+    void release();
+    void discard_front(size_t n);
+    void discard_back(size_t n);
+
     A alloc;
     T* data_;
-    T* begin_;
-    T* end_;
+    size_t head_;
     size_t size_;
     size_t capacity_;
-
-    bool isFull;
+    size_t mask_;
+    bool pow2_;
+    // storage owned by a derived object (CCircularBufferExt with K > 0); never deallocated.
+    // The base move and swap only exchange blocks: the derived class moves inline elements itself.
+    T* inline_;
+    size_t inlineCapacity_;
+    CFullPolicy full_ = CFullPolicy::Overwrite;
+    size_t overwritten_ = 0;
+    size_t dropped_ = 0;
+    [[no_unique_address]] S stats_;
 };
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::size_type CCircularBuffer<T, A>::max_size() const {
+template<class T, class A, class S>
+typename CCircularBuffer<T, A, S>::size_type CCircularBuffer<T, A, S>::max_size() const {
     return std::numeric_limits<size_type>::max() / sizeof(typename A::value_type);
 }
 
-template<class T, class A>
-T* CCircularBuffer<T, A>::Iterator::linearize() const {
-    return isEnd ? cont_->data_ + cont_->size_ :
-           (point < cont_->begin_ ? point + (cont_->data_ + cont_->capacity_ - cont_->begin_)
-                                  : cont_->data_ + (point - cont_->begin_));
-}
-
-template<class T, class A>
-T* CCircularBuffer<T, A>::const_Iterator::linearize() const {
-    return isEnd ? cont_->data_ + cont_->size_ :
-           (point < cont_->begin_ ? point + (cont_->data_ + cont_->capacity_ - cont_->begin_)
-                                  : cont_->data_ + (point - cont_->begin_));
-}
-
-template<class T, class A>
-typename CCircularBuffer<T, A>::Iterator &CCircularBuffer<T, A>::Iterator::operator++() {
-    point++;
-    if (point == cont_->data_ + cont_->capacity_) {
-        point = cont_->data_;
+// Leaves k unconstructed slots at logical positions [pos, pos + k).
+// Without reallocation only the shorter of the prefix and the suffix is shifted;
+// with reallocation every element is relocated exactly once around the gap.
+template<class T, class A, class S>
+void CCircularBuffer<T, A, S>::open_gap(size_t pos, size_t k) {
+    if (k == 0) {
+        return;
     }
-    if (this->isEnd) {
-        point = cont_->begin_;
-        this->isBegin = true;
-        this->isEnd = false;
-    } else if (point == cont_->end_) {
-        this->isEnd = true;
-        this->isBegin = false;
+    if (size_ + k > capacity_) {
+        size_t newCapacity = std::max(size_ + k, capacity_ * 2 + 1);
+        if (pow2_) {
+            newCapacity = std::bit_ceil(newCapacity);
+        }
+        auto timer = stats_.start();
+        T* data_temp = allocate(newCapacity, true);
+        relocate(0, pos, data_temp);
+        relocate(pos, size_ - pos, data_temp + pos + k);
+        release();
+        data_ = data_temp;
+        capacity_ = newCapacity;
+        mask_ = newCapacity - 1;
+        head_ = 0;
+        stats_.reallocated(timer, size_ * sizeof(T));
+    } else if (pos < size_ - pos) {
+        size_t head = wrap(head_ + capacity_ - k);
+        for (size_t i = 0; i < pos; i++) {
+            T* to = data_ + wrap(head + i);
+            if (i < k) {
+                std::construct_at(to, std::move(*slot(i)));
+            } else {
+                *to = std::move(*slot(i));
+            }
+        }
+        for (size_t i = std::max(pos, k) - k; i < pos; i++) {
+            std::destroy_at(slot(i));
+        }
+        head_ = head;
     } else {
-        this->isEnd = false;
-        this->isBegin = false;
+        for (size_t i = size_; i-- > pos;) {
+            if (i + k >= size_) {
+                std::construct_at(slot(i + k), std::move(*slot(i)));
+            } else {
+                *slot(i + k) = std::move(*slot(i));
+            }
+        }
+        for (size_t i = pos; i < std::min(pos + k, size_); i++) {
+            std::destroy_at(slot(i));
+        }
     }
-    return *this;
+    size_ += k;
+    stats_.inserted(pos, k, size_);
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::Iterator CCircularBuffer<T, A>::Iterator::operator++(int) {
-    point++;
-    if (point == cont_->data_ + cont_->capacity_) {
-        point = cont_->data_;
-    }
-    if (this->isEnd) {
-        point = cont_->begin_;
-        this->isBegin = true;
-        this->isEnd = false;
-    } else if (point == cont_->end_) {
-        this->isEnd = true;
-        this->isBegin = false;
-    } else {
-        this->isEnd = false;
-        this->isBegin = false;
-    }
-    return *this;
+template<class T, class A, class S>
+typename CCircularBuffer<T, A, S>::Iterator CCircularBuffer<T, A, S>::insert(Iterator it, const T& data) {
+    return emplace(it, data);
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::const_Iterator CCircularBuffer<T, A>::const_Iterator::operator++(int) {
-    point++;
-    if (point == cont_->data_ + cont_->capacity_) {
-        point = cont_->data_;
-    }
-    if (this->isEnd) {
-        point = cont_->begin_;
-        this->isBegin = true;
-        this->isEnd = false;
-    } else if (point == cont_->end_) {
-        this->isEnd = true;
-        this->isBegin = false;
-    } else {
-        this->isEnd = false;
-        this->isBegin = false;
-    }
-    return *this;
+template<class T, class A, class S>
+typename CCircularBuffer<T, A, S>::Iterator CCircularBuffer<T, A, S>::insert(Iterator it, T&& data) {
+    return emplace(it, std::move(data));
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::const_Iterator& CCircularBuffer<T, A>::const_Iterator::operator++() {
-    point++;
-    if (point == cont_->data_ + cont_->capacity_) {
-        point = cont_->data_;
-    }
-    if (this->isEnd) {
-        point = cont_->begin_;
-        this->isBegin = true;
-        this->isEnd = false;
-    } else if (point == cont_->end_) {
-        this->isEnd = true;
-        this->isBegin = false;
-    } else {
-        this->isEnd = false;
-        this->isBegin = false;
+// How many of k elements inserted at pos are stored when they do not fit and the buffer cannot grow.
+// Under Overwrite the elements in front of pos are discarded first, then the first inserted ones;
+// as for bulk pushes every element lost this way counts as overwritten. pos moves with the front.
+template<class T, class A, class S>
+size_t CCircularBuffer<T, A, S>::admit(size_t& pos, size_t k) {
+    if (size_ + k <= capacity_ || full_ == CFullPolicy::Grow) [[likely]] {
+        return k;
     }
-    return *this;
-}
-
-template<class T, class A>
-typename CCircularBuffer<T, A>::Iterator &CCircularBuffer<T, A>::Iterator::operator--() {
-    point--;
-    if (point == cont_->data_ - 1) {
-        point = cont_->data_ + cont_->capacity_ - 1;
+    if (full_ == CFullPolicy::Reject || capacity_ == 0) {
+        dropped_ += k;
+        stats_.dropped(k);
+        return 0;
     }
-    if (this->isBegin) {
-        point = cont_->end_;
-        this->isBegin = false;
-        this->isEnd = true;
-    } else if (point == cont_->begin_) {
-        this->isBegin = true;
-        this->isEnd = false;
-    } else {
-        this->isBegin = false;
-        this->isEnd = false;
+    size_t excess = size_ + k - capacity_;
+    size_t front = std::min(excess, pos);
+    overwritten_ += excess;
+    stats_.overwrote(excess);
+    discard_front(front);
+    pos -= front;
+    return k - (excess - front);
+}
+
+// The new value is built before any element is moved or discarded, so arguments may refer to elements of the buffer.
+template<class T, class A, class S>
+template<class... Args>
+typename CCircularBuffer<T, A, S>::Iterator CCircularBuffer<T, A, S>::emplace(Iterator it, Args&&... args) {
+    T value(std::forward<Args>(args)...);
+    size_t pos = it.index_;
+    if (admit(pos, 1) == 0) {
+        return end();
     }
-    return *this;
+    open_gap(pos, 1);
+    std::construct_at(slot(pos), std::move(value));
+    return Iterator(this, pos);
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::Iterator CCircularBuffer<T, A>::Iterator::operator--(int) {
-    point--;
-    if (point == cont_->data_ - 1) {
-        point = cont_->data_ + cont_->capacity_ - 1;
-    }
-    if (this->isBegin) {
-        point = cont_->end_;
-        this->isBegin = false;
-        this->isEnd = true;
-    } else if (point == cont_->begin_) {
-        this->isBegin = true;
-        this->isEnd = false;
-    } else {
-        this->isBegin = false;
-        this->isEnd = false;
+template<class T, class A, class S>
+typename CCircularBuffer<T, A, S>::Iterator CCircularBuffer<T, A, S>::insert(Iterator it, size_t n, const T& data) {
+    if (n == 0) {
+        return it;
     }
-    return *this;
-}
-
-template<class T, class A>
-typename CCircularBuffer<T, A>::const_Iterator CCircularBuffer<T, A>::const_Iterator::operator--(int) {
-    point--;
-    if (point == cont_->data_ - 1) {
-        point = cont_->data_ + cont_->capacity_ - 1;
+    T value(data);
+    size_t pos = it.index_;
+    n = admit(pos, n);
+    if (n == 0) {
+        return end();
     }
-    if (this->isBegin) {
-        point = cont_->end_;
-        this->isBegin = false;
-        this->isEnd = true;
-    } else if (point == cont_->begin_) {
-        this->isBegin = true;
-        this->isEnd = false;
-    } else {
-        this->isBegin = false;
-        this->isEnd = false;
+    open_gap(pos, n);
+    for (size_t i = 0; i < n; i++) {
+        std::construct_at(slot(pos + i), value);
     }
-    return *this;
+    return Iterator(this, pos);
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::const_Iterator &CCircularBuffer<T, A>::const_Iterator::operator--() {
-    point--;
-    if (point == cont_->data_ - 1) {
-        point = cont_->data_ + cont_->capacity_ - 1;
+template<class T, class A, class S>
+template<std::forward_iterator iter>
+typename CCircularBuffer<T, A, S>::Iterator CCircularBuffer<T, A, S>::insert(Iterator it, const iter& it1, const iter& it2) {
+    size_t pos = it.index_;
+    size_t n = std::distance(it1, it2);
+    if (n == 0) {
+        return it;
     }
-    if (this->isBegin) {
-        point = cont_->end_;
-        this->isBegin = false;
-        this->isEnd = true;
-    } else if (point == cont_->begin_) {
-        this->isBegin = true;
-        this->isEnd = false;
-    } else {
-        this->isBegin = false;
-        this->isEnd = false;
+    size_t stored = admit(pos, n);
+    if (stored == 0) {
+        return end();
     }
-    return *this;
+    open_gap(pos, stored);
+    size_t i = pos;
+    auto temp = it1;
+    std::advance(temp, n - stored);
+    for (; temp != it2; temp++, i++){
+        std::construct_at(slot(i), *temp);
+    }
+    return Iterator(this, pos);
 }
 
+template<class T, class A, class S>
+typename CCircularBuffer<T, A, S>::Iterator CCircularBuffer<T, A, S>::insert(CCircularBuffer<T, A, S>::Iterator it, std::initializer_list<T> list) {
+    return insert(it, list.begin(), list.end());
+}
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::Iterator &CCircularBuffer<T, A>::Iterator::operator+=(const difference_type n) {
-    if (n > 0) {
-        if (n == cont_->end() - *this) {
-            isEnd = true;
-            isBegin = false;
-            point = cont_->end_;
-            return *this;
-        }
-        if (n - 1 == cont_->end() - *this) {
-            isEnd = false;
-            isBegin = true;
-            point = cont_->begin_;
-            return *this;
-        }
-        point = add(point, n);
-        isEnd = false;
-        isBegin = false;
-    } else if (n < 0) {
-        *this -= -n;
+template<class T, class A, class S>
+typename CCircularBuffer<T, A, S>::Iterator CCircularBuffer<T, A, S>::erase(Iterator it) {
+    if (static_cast<size_t>(it.index_) >= size_) {
+        return it;
     }
-    return *this;
+    return erase(it, it + 1);
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::const_Iterator &CCircularBuffer<T, A>::const_Iterator::operator+=(const difference_type n) {
-    if (n > 0) {
-        if (n == cont_->cend() - *this) {
-            isEnd = true;
-            isBegin = false;
-            point = cont_->end_;
-            return *this;
-        }
-        if (n - 1 == cont_->cend() - *this) {
-            isEnd = false;
-            isBegin = true;
-            point = cont_->begin_;
-            return *this;
-        }
-        point = sub(point, n);
-
-        isEnd = false;
-        isBegin = false;
-    } else if (n < 0) {
-        *this -= -n;
-    }
-    return *this;
+template<class T, class A, class S>
+typename CCircularBuffer<T, A, S>::const_Iterator CCircularBuffer<T, A, S>::erase(const_Iterator it) {
+    erase(Iterator(this, it.index_));
+    return it;
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::Iterator &CCircularBuffer<T, A>::Iterator::operator-=(const difference_type n) {
-    if (n > 0) {
-        if (n == *this - cont_->begin()) {
-            isBegin = true;
-            isEnd = false;
-            point = cont_->begin_;
-            return *this;
+// Closes the hole by shifting whichever of the prefix and the suffix is shorter.
+template<class T, class A, class S>
+typename CCircularBuffer<T, A, S>::Iterator CCircularBuffer<T, A, S>::erase(Iterator it1, Iterator it2) {
+    size_t pos = it1.index_;
+    size_t k = it2.index_ - it1.index_;
+    if (k == 0) {
+        return it1;
+    }
+    if (pos < size_ - pos - k) {
+        for (size_t i = pos; i-- > 0;) {
+            *slot(i + k) = std::move(*slot(i));
         }
-        if (n - 1 == *this - cont_->begin()) {
-            isBegin = false;
-            isEnd = true;
-            point = cont_->end_;
-            return *this;
+        for (size_t i = 0; i < k; i++) {
+            std::destroy_at(slot(i));
         }
-        point = sub(point, n);
-        isEnd = false;
-        isBegin = false;
-    } else if (n < 0) {
-        *this += -n;
-    }
-    return *this;
-}
-
-template<class T, class A>
-typename CCircularBuffer<T, A>::const_Iterator &CCircularBuffer<T, A>::const_Iterator::operator-=(const difference_type n) {
-    if (n > 0) {
-        if (n == *this - cont_->cbegin()) {
-            isBegin = true;
-            isEnd = false;
-            point = cont_->begin_;
-            return *this;
+        head_ = wrap(head_ + k);
+    } else {
+        for (size_t i = pos + k; i < size_; i++) {
+            *slot(i - k) = std::move(*slot(i));
         }
-        if (n - 1 == *this - cont_->cbegin()) {
-            isBegin = false;
-            isEnd = true;
-            point = cont_->end_;
-            return *this;
+        for (size_t i = size_ - k; i < size_; i++) {
+            std::destroy_at(slot(i));
         }
-        point = sub(point, n);
-        isEnd = false;
-        isBegin = false;
-    } else if (n < 0) {
-        *this += -n;
     }
-    return *this;
+    size_ -= k;
+    stats_.erased(pos, k);
+    return Iterator(this, pos);
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::difference_type CCircularBuffer<T, A>::Iterator::operator-(const typename CCircularBuffer<T, A>::Iterator other) {
-    Iterator temp = other;
-    return this->linearize() - temp.linearize();
+template<class T, class A, class S>
+typename CCircularBuffer<T, A, S>::const_Iterator CCircularBuffer<T, A, S>::erase(const_Iterator it1, const_Iterator it2) {
+    erase(Iterator(this, it1.index_), Iterator(this, it2.index_));
+    return it1;
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::Iterator CCircularBuffer<T, A>::Iterator::operator+(const difference_type n) {
-    Iterator temp(*this);
-    temp += n;
-    return temp;
+template<class T, class A, class S>
+void CCircularBuffer<T, A, S>::push_front(const T& value){
+    emplace_front(value);
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::Iterator CCircularBuffer<T, A>::Iterator::operator-(const difference_type n) {
-    Iterator temp(*this);
-    temp -= n;
-    return temp;
+template<class T, class A, class S>
+void CCircularBuffer<T, A, S>::push_front(T&& value){
+    emplace_front(std::move(value));
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::difference_type CCircularBuffer<T, A>::const_Iterator::operator-(const typename CCircularBuffer<T, A>::const_Iterator& other) {
-    const_Iterator temp = other;
-    return this->linearize() - temp.linearize();
+template<class T, class A, class S>
+template<class... Args>
+void CCircularBuffer<T, A, S>::emplace_front(Args&&... args){
+    try_emplace_front(std::forward<Args>(args)...);
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::const_Iterator CCircularBuffer<T, A>::const_Iterator::operator+(const difference_type n) {
-    const_Iterator temp(*this);
-    temp += n;
-    return temp;
+template<class T, class A, class S>
+bool CCircularBuffer<T, A, S>::try_push_front(const T& value) {
+    return try_emplace_front(value);
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::const_Iterator CCircularBuffer<T, A>::const_Iterator::operator-(const difference_type n) {
-    const_Iterator temp(*this);
-    temp -= n;
-    return temp;
+template<class T, class A, class S>
+bool CCircularBuffer<T, A, S>::try_push_front(T&& value) {
+    return try_emplace_front(std::move(value));
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::Iterator CCircularBuffer<T, A>::insert(Iterator it, const T data) {
-    size_t dist = it - begin();
-    if (size_ == capacity_) {
-        reserve(capacity_ * 2 + 1);
-    } else {
-        reserve(capacity_);
-    }
-    it = Iterator(data_ + dist, it.cont_, it.isBegin, it.isEnd);
-    if (size_ == 0) {
-        std::construct_at(data_, data);
-        size_++;
-        begin_ = data_;
-        end_ = data_;
-        it.point = data_;
-        isFull = size_ == capacity_;
-        return it;
-    }
-    end_++;
-    size_++;
-    if (end_ == data_ + capacity_) {
-        end_ = begin_;
-    }
-    if (!it.isEnd) {
-        Iterator end = this->end();
-        Iterator it1 = end--;
-        Iterator it2 = end--;
-        for (; it2 != it; it1--, it2--) {
-            std::destroy_at(it1.point);
-            std::construct_at(it1.point, *it2.point);
+// On a full buffer under Overwrite the newest element is overwritten; the slot it occupies is the one before front().
+template<class T, class A, class S>
+template<class... Args>
+bool CCircularBuffer<T, A, S>::try_emplace_front(Args&&... args) {
+    if (size_ == capacity_) [[unlikely]] {
+        if (full_ == CFullPolicy::Grow) {
+            T value(std::forward<Args>(args)...);
+            reallocate(capacity_ == 0 ? 1 : 2 * capacity_, true);
+            head_ = wrap(head_ + capacity_ - 1);
+            std::construct_at(data_ + head_, std::move(value));
+            size_++;
+            stats_.pushed_front(1, size_);
+            return true;
         }
-        std::destroy_at(it1.point);
-        std::construct_at(it1.point, *it2.point);
+        if (full_ == CFullPolicy::Reject || capacity_ == 0) {
+            dropped_++;
+            stats_.dropped(1);
+            return false;
+        }
+        head_ = wrap(head_ + capacity_ - 1);
+        data_[head_] = T(std::forward<Args>(args)...);
+        overwritten_++;
+        stats_.pushed_front(1, size_);
+        stats_.overwrote(1);
+        return true;
     }
-    std::destroy_at(it.point);
-    std::construct_at(it.point, data);
-    return it;
+    head_ = wrap(head_ + capacity_ - 1);
+    std::construct_at(data_ + head_, std::forward<Args>(args)...);
+    size_++;
+    stats_.pushed_front(1, size_);
+    return true;
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::Iterator CCircularBuffer<T, A>::insert(Iterator it, size_t n, const T data) {
-    for (size_t i = 0; i < n; i++) {
-        it = insert(it, data);
+template<class T, class A, class S>
+void CCircularBuffer<T, A, S>::pop_front(){
+    if (size_ == 0) {
+        return;
     }
-    return it;
+    std::destroy_at(data_ + head_);
+    head_ = wrap(head_ + 1);
+    size_--;
+    stats_.popped_front(1);
 }
 
-template<class T, class A>
-template<std::forward_iterator iter>
-typename CCircularBuffer<T, A>::Iterator CCircularBuffer<T, A>::insert(Iterator it, const iter& it1, const iter& it2) {
-    for (auto temp = it1; temp != it2; temp++){
-        it = insert(it, *temp);
-    }
-    return it;
+template<class T, class A, class S>
+void CCircularBuffer<T, A, S>::push_back(const T& elem) {
+    emplace_back(elem);
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::Iterator CCircularBuffer<T, A>::insert(CCircularBuffer<T, A>::Iterator it, std::initializer_list<T> list) {
-    for (auto temp = list.begin(); temp != list.end(); temp++){
-        it = insert(it, *temp);
-    }
-    return it;
+template<class T, class A, class S>
+void CCircularBuffer<T, A, S>::push_back(T&& elem) {
+    emplace_back(std::move(elem));
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::Iterator CCircularBuffer<T, A>::erase(Iterator it) {
-    if (it.isEnd || size_ == 0) {
-        return it;
-    }
-    Iterator next = it;
-    next++;
-    for(Iterator p = it; next != it.cont_->end(); p = next, next++){
-        std::destroy_at(p.point);
-        std::construct_at(p.point, *next.point);
-    }
-    it.cont_->end_--;
-    if (it.cont_->end_ == it.cont_->data_ - 1) {
-        it.cont_->end_ = it.cont_->data_ + it.cont_->capacity_ - 1;
-    }
-    it.cont_->size_--;
-    isFull = false;
-    return it;
+template<class T, class A, class S>
+template<class... Args>
+void CCircularBuffer<T, A, S>::emplace_back(Args&&... args) {
+    try_emplace_back(std::forward<Args>(args)...);
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::const_Iterator CCircularBuffer<T, A>::erase(const_Iterator it) {
-    if (it.isEnd || size_ == 0) {
-        return it;
-    }
-    const_Iterator next = it;
-    next++;
-    for(const_Iterator p = it; next != it.cont_->cend(); p = next, next++){
-        std::destroy_at(p.point);
-        std::construct_at(p.point, *next.point);
-    }
-    it.cont_->end_--;
-    if (it.cont_->end_ == it.cont_->data_ - 1) {
-        it.cont_->end_ = it.cont_->data_ + it.cont_->capacity_ - 1;
-    }
-    it.cont_->size_--;
-    isFull = false;
-    return it;
+template<class T, class A, class S>
+bool CCircularBuffer<T, A, S>::try_push_back(const T& elem) {
+    return try_emplace_back(elem);
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::Iterator CCircularBuffer<T, A>::erase(Iterator it1, Iterator it2) {
-    Iterator it = it1;
-    size_t n = it2 - it1;
-    for (size_t i = 0; i < n; i++) {
-        erase(it);
-    }
-    return it;
+template<class T, class A, class S>
+bool CCircularBuffer<T, A, S>::try_push_back(T&& elem) {
+    return try_emplace_back(std::move(elem));
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::const_Iterator CCircularBuffer<T, A>::erase(const_Iterator it1, const_Iterator it2) {
-    const_Iterator it = it1;
-    size_t n = it2 - it1;
-    for (size_t i = 0; i < n; i++) {
-        erase(it);
+// On a full buffer under Overwrite the oldest element is assigned the new value and front() moves forward.
+template<class T, class A, class S>
+template<class... Args>
+bool CCircularBuffer<T, A, S>::try_emplace_back(Args&&... args) {
+    if (size_ == capacity_) [[unlikely]] {
+        if (full_ == CFullPolicy::Grow) {
+            T value(std::forward<Args>(args)...);
+            reallocate(capacity_ == 0 ? 1 : 2 * capacity_, true);
+            std::construct_at(slot(size_), std::move(value));
+            size_++;
+            stats_.pushed_back(1, size_);
+            return true;
+        }
+        if (full_ == CFullPolicy::Reject || capacity_ == 0) {
+            dropped_++;
+            stats_.dropped(1);
+            return false;
+        }
+        data_[head_] = T(std::forward<Args>(args)...);
+        head_ = wrap(head_ + 1);
+        overwritten_++;
+        stats_.pushed_back(1, size_);
+        stats_.overwrote(1);
+        return true;
     }
-    return it;
+    std::construct_at(slot(size_), std::forward<Args>(args)...);
+    size_++;
+    stats_.pushed_back(1, size_);
+    return true;
 }
 
-template<class T, class A>
-void CCircularBuffer<T, A>::push_front(const T& value){
-    if(capacity_ == 0) {
+template<class T, class A, class S>
+void CCircularBuffer<T, A, S>::pop_back(){
+    if (size_ == 0) {
         return;
     }
-    if (size_ == capacity_) {
-        std::destroy_at(data_ + (begin_ - data_ + capacity_ - 1) % capacity_);
-        end_ = data_ + (end_ - data_ + capacity_ - 1) % capacity_;
-        begin_ = data_ + (begin_ - data_ + capacity_ - 1) % capacity_;
-        std::construct_at(begin_, value);
+    size_--;
+    std::destroy_at(slot(size_));
+    stats_.popped_back(1);
+}
+
+template<class T, class A, class S>
+template<class iter>
+iter CCircularBuffer<T, A, S>::construct_run(T* dest, iter src, size_t n) {
+    if constexpr (std::is_trivially_copyable_v<T> && std::contiguous_iterator<iter> &&
+                  std::is_same_v<std::iter_value_t<iter>, T>) {
+        if (n != 0) {
+            std::memcpy(dest, std::to_address(src), n * sizeof(T));
+        }
+        return src + n;
     } else {
-        begin_ = data_ + (begin_ - data_ + capacity_ - 1) % capacity_;
-        std::construct_at(begin_, value);
-        size_++;
+        for (size_t i = 0; i < n; i++, src++) {
+            std::construct_at(dest + i, *src);
+        }
+        return src;
     }
-    isFull = size_ == capacity_;
 }
 
-template<class T, class A>
-void CCircularBuffer<T, A>::pop_front(){
-    if (size_ == 0) {
+template<class T, class A, class S>
+template<class iter>
+iter CCircularBuffer<T, A, S>::copy_run(const T* src, iter dest, size_t n) {
+    if constexpr (std::is_trivially_copyable_v<T> && std::contiguous_iterator<iter> &&
+                  std::is_same_v<std::iter_value_t<iter>, T>) {
+        if (n != 0) {
+            std::memcpy(std::to_address(dest), src, n * sizeof(T));
+        }
+        return dest + n;
+    } else {
+        return std::copy_n(src, n, dest);
+    }
+}
+
+template<class T, class A, class S>
+template<std::forward_iterator iter>
+void CCircularBuffer<T, A, S>::push_back(iter it1, iter it2) {
+    size_t n = std::distance(it1, it2);
+    if (size_ + n > capacity_ && full_ == CFullPolicy::Grow) {
+        reallocate(std::max(2 * capacity_, size_ + n), true);
+    }
+    if (n == 0) {
         return;
     }
-    if (size_ == 1) {
-        clear();
+    if (size_ + n > capacity_) {
+        if (full_ == CFullPolicy::Reject || capacity_ == 0) {
+            dropped_ += size_ + n - capacity_;
+            stats_.dropped(size_ + n - capacity_);
+            n = capacity_ - size_;
+        } else {
+            overwritten_ += size_ + n - capacity_;
+            stats_.overwrote(size_ + n - capacity_);
+        }
+    }
+    if (n == 0) {
         return;
     }
-    std::destroy_at(begin_);
-    size_--;
-    begin_++;
-    if (begin_ == data_ + capacity_) {
-        begin_ = data_;
+    if (n >= capacity_) {
+        std::advance(it1, n - capacity_);
+        n = capacity_;
+        discard_front(size_);
+    } else if (size_ + n > capacity_) {
+        discard_front(size_ + n - capacity_);
     }
-    isFull = false;
+    size_t tail = wrap(head_ + size_);
+    size_t first = std::min(n, capacity_ - tail);
+    it1 = construct_run(data_ + tail, it1, first);
+    construct_run(data_, it1, n - first);
+    size_ += n;
+    stats_.pushed_back(n, size_);
 }
 
-template<class T, class A>
-void CCircularBuffer<T, A>::push_back(const T& elem) {
-    if(capacity_ == 0) {
+template<class T, class A, class S>
+template<std::forward_iterator iter>
+void CCircularBuffer<T, A, S>::push_front(iter it1, iter it2) {
+    size_t n = std::distance(it1, it2);
+    if (size_ + n > capacity_ && full_ == CFullPolicy::Grow) {
+        reallocate(std::max(2 * capacity_, size_ + n), true);
+    }
+    if (n == 0) {
         return;
     }
-    std::construct_at(end_, elem);
-    if (size_ == capacity_) {
-        begin_++;
-        if (begin_ == data_ + capacity_) {
-            begin_ = data_;
+    if (size_ + n > capacity_) {
+        if (full_ == CFullPolicy::Reject || capacity_ == 0) {
+            dropped_ += size_ + n - capacity_;
+            stats_.dropped(size_ + n - capacity_);
+            std::advance(it1, size_ + n - capacity_);
+            n = capacity_ - size_;
+        } else {
+            overwritten_ += size_ + n - capacity_;
+            stats_.overwrote(size_ + n - capacity_);
         }
-        end_ = begin_;
-    } else {
-        end_++;
-        if (end_ == data_ + capacity_) {
-            end_ = data_;
+    }
+    if (n == 0) {
+        return;
+    }
+    if (n >= capacity_) {
+        n = capacity_;
+        discard_back(size_);
+    } else if (size_ + n > capacity_) {
+        discard_back(size_ + n - capacity_);
+    }
+    head_ = wrap(head_ + capacity_ - n);
+    size_t first = std::min(n, capacity_ - head_);
+    it1 = construct_run(data_ + head_, it1, first);
+    construct_run(data_, it1, n - first);
+    size_ += n;
+    stats_.pushed_front(n, size_);
+}
+
+template<class T, class A, class S>
+void CCircularBuffer<T, A, S>::pop_front(size_t n) {
+    n = std::min(n, size_);
+    discard_front(n);
+    stats_.popped_front(n);
+}
+
+template<class T, class A, class S>
+void CCircularBuffer<T, A, S>::pop_back(size_t n) {
+    n = std::min(n, size_);
+    discard_back(n);
+    stats_.popped_back(n);
+}
+
+// Destroy n <= size() elements at one end without reporting them to the statistics policy,
+// for elements that are overwritten rather than popped.
+template<class T, class A, class S>
+void CCircularBuffer<T, A, S>::discard_front(size_t n) {
+    size_t first = std::min(n, capacity_ - head_);
+    std::destroy_n(data_ + head_, first);
+    std::destroy_n(data_, n - first);
+    head_ = wrap(head_ + n);
+    size_ -= n;
+}
+
+template<class T, class A, class S>
+void CCircularBuffer<T, A, S>::discard_back(size_t n) {
+    size_ -= n;
+    size_t tail = wrap(head_ + size_);
+    size_t first = std::min(n, capacity_ - tail);
+    std::destroy_n(data_ + tail, first);
+    std::destroy_n(data_, n - first);
+}
+
+template<class T, class A, class S>
+template<class iter>
+size_t CCircularBuffer<T, A, S>::copy_out(iter dest, size_t n) const {
+    n = std::min(n, size_);
+    std::span<const T> one = array_one();
+    size_t first = std::min(n, one.size());
+    dest = copy_run(one.data(), dest, first);
+    copy_run(data_, dest, n - first);
+    return n;
+}
+
+template<class T, class A, class S>
+void CCircularBuffer<T, A, S>::reserve(size_t newCapacity){
+    stats_.reserved();
+    reallocate(newCapacity, false);
+}
+
+// With atLeast the allocator may return more than n slots through allocate_at_least;
+// n is then updated to the usable count, which stays a power of two in power-of-two mode.
+template<class T, class A, class S>
+T* CCircularBuffer<T, A, S>::allocate(size_t& n, bool atLeast) {
+    if constexpr (requires { alloc.allocate_at_least(n); }) {
+        if (atLeast) {
+            auto result = alloc.allocate_at_least(n);
+            n = pow2_ ? std::bit_floor(result.count) : result.count;
+            return result.ptr;
         }
-        size_++;
-        isFull = size_ == capacity_;
     }
+    return std::allocator_traits<A>::allocate(alloc, n);
 }
 
-template<class T, class A>
-void CCircularBuffer<T, A>::pop_back(){
-    if (size_ == 0) {
+// Moves logical elements [from, from + n) into raw storage at dest and ends their lifetime in the ring.
+// Relocatable types take at most two memcpys, one per contiguous run.
+template<class T, class A, class S>
+void CCircularBuffer<T, A, S>::relocate(size_t from, size_t n, T* dest) {
+    if (n == 0) {
         return;
     }
-    if (size_ == 1) {
-        clear();
-        return;
-    }
-    end_--;
-    if (end_ == data_ - 1) {
-        if (size_ == capacity_) {
-            end_ = data_ + capacity_ - 1;
-        } else {
-            end_ = data_ + capacity_;
+    if constexpr (CTriviallyRelocatable<T>::value) {
+        size_t start = wrap(head_ + from);
+        size_t first = std::min(n, capacity_ - start);
+        std::memcpy(static_cast<void*>(dest), static_cast<const void*>(data_ + start), first * sizeof(T));
+        std::memcpy(static_cast<void*>(dest + first), static_cast<const void*>(data_), (n - first) * sizeof(T));
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            T* src = slot(from + i);
+            std::construct_at(dest + i, std::move_if_noexcept(*src));
+            std::destroy_at(src);
         }
     }
-    size_--;
-    isFull = false;
 }
 
-template<class T, class A>
-void CCircularBuffer<T, A>::reserve(size_t newCapacity){
-    if (size_ == 0) {
-        alloc.deallocate(data_, capacity_);
-        capacity_ = newCapacity;
-        data_ = alloc.allocate(capacity_);
-        begin_ = data_;
-        end_ = data_;
-        return;
+template<class T, class A, class S>
+void CCircularBuffer<T, A, S>::reallocate(size_t newCapacity, bool atLeast) {
+    newCapacity = std::max(newCapacity, size_);
+    if (pow2_) {
+        newCapacity = std::bit_ceil(newCapacity);
     }
-    T* data_temp = alloc.allocate(newCapacity);
-    size_t i = 0;
-    for(Iterator it = begin(); it != end(); it++, i++) {
-        std::construct_at(data_temp + i, *it);
-        std::destroy_at(it.point);
+    if (newCapacity <= inline_capacity()) {
+        if (is_inline()) {
+            return;
+        }
+        auto timer = stats_.start();
+        relocate(0, size_, inline_);
+        release();
+        data_ = inline_;
+        capacity_ = inline_capacity();
+        mask_ = capacity_ - 1;
+        head_ = 0;
+        stats_.reallocated(timer, size_ * sizeof(T));
+        return;
     }
-    alloc.deallocate(data_, capacity_);
+    auto timer = stats_.start();
+    T* data_temp = allocate(newCapacity, atLeast);
+    relocate(0, size_, data_temp);
+    release();
     capacity_ = newCapacity;
+    mask_ = newCapacity - 1;
     data_ = data_temp;
-    begin_ = data_;
-    end_ = size_ < capacity_ ? data_ + size_ : data_;
-    isFull = size_ == capacity_;
+    head_ = 0;
+    stats_.reallocated(timer, size_ * sizeof(T));
 }
 
-template<class T, class A>
-void CCircularBuffer<T, A>::resize(size_t newSize) {
+template<class T, class A, class S>
+void CCircularBuffer<T, A, S>::resize(size_t newSize) {
     if (newSize > size_) {
         if (newSize > capacity_) {
             reserve(newSize);
@@ -730,338 +801,365 @@ void CCircularBuffer<T, A>::resize(size_t newSize) {
     size_ = newSize;
 }
 
-template<class T, class A>
+template<class T, class A, class S>
 template<std::forward_iterator iter>
-void CCircularBuffer<T, A>::assign(iter it1, iter it2) {
-    CCircularBuffer<T, A> temp(it1, it2);
+void CCircularBuffer<T, A, S>::assign(iter it1, iter it2) {
+    CCircularBuffer<T, A, S> temp(it1, it2);
     this->swap(temp);
 }
 
-template<class T, class A>
-void CCircularBuffer<T, A>::assign(std::initializer_list<T> il) {
-    CCircularBuffer<T, A> temp(il);
+template<class T, class A, class S>
+void CCircularBuffer<T, A, S>::assign(std::initializer_list<T> il) {
+    CCircularBuffer<T, A, S> temp(il);
     this->swap(temp);
 }
 
-template<class T, class A>
-void CCircularBuffer<T, A>::assign(size_t n, T t) {
-    CCircularBuffer<T, A> temp(n, t);
+template<class T, class A, class S>
+void CCircularBuffer<T, A, S>::assign(size_t n, const T& t) {
+    CCircularBuffer<T, A, S> temp(n, t);
     this->swap(temp);
 }
 
-template<class T, class A>
-void CCircularBuffer<T, A>::clear() {
-    for (size_t i = 0; i < size_; i++) {
-        std::destroy_at(data_ + i);
-    }
+template<class T, class A, class S>
+void CCircularBuffer<T, A, S>::clear() {
+    std::span<T> one = array_one();
+    std::span<T> two = array_two();
+    std::destroy(one.begin(), one.end());
+    std::destroy(two.begin(), two.end());
     size_ = 0;
-    begin_ = data_;
-    end_ = data_;
-    isFull = false;
+    head_ = 0;
+    stats_.replaced(0);
+}
+
+template<class T, class A, class S>
+CCircularBuffer<T, A, S>::CCircularBuffer(const CCircularBuffer& cont): data_(alloc.allocate(cont.capacity_)), head_(0),
+                                                                     size_(cont.size_), capacity_(cont.capacity_),
+                                                                     mask_(cont.mask_), pow2_(cont.pow2_), inline_(nullptr), inlineCapacity_(0),
+                                                                     full_(cont.full_) {
+    std::span<const T> one = cont.array_one();
+    std::span<const T> two = cont.array_two();
+    construct_run(data_, one.data(), one.size());
+    construct_run(data_ + one.size(), two.data(), two.size());
+    stats_.replaced(size_);
+}
+
+template<class T, class A, class S>
+CCircularBuffer<T, A, S>::CCircularBuffer(CCircularBuffer&& cont) noexcept: alloc(cont.alloc), inline_(nullptr), inlineCapacity_(0),
+                                                                          full_(cont.full_) {
+    data_ = cont.data_;
+    head_ = cont.head_;
+    size_ = cont.size_;
+    capacity_ = cont.capacity_;
+    mask_ = cont.mask_;
+    pow2_ = cont.pow2_;
+    cont.data_ = cont.inline_;
+    cont.head_ = 0;
+    cont.size_ = 0;
+    cont.capacity_ = cont.inline_capacity();
+    cont.mask_ = cont.capacity_ - 1;
+    stats_.replaced(size_);
+    cont.stats_.replaced(0);
+}
+
+template<class T, class A, class S>
+CCircularBuffer<T, A, S>& CCircularBuffer<T, A, S>::operator=(const CCircularBuffer& cont) {
+    if (this != &cont) {
+        CCircularBuffer<T, A, S> temp(cont);
+        this->swap(temp);
+    }
+    return *this;
 }
 
-template<class T, class A>
-CCircularBuffer<T, A>::CCircularBuffer(const CCircularBuffer& cont): size_(cont.size_), capacity_(cont.capacity_), isFull(cont.isFull) {
-    data_ = alloc.allocate(capacity_);
-    size_t i = 0;
-    if (capacity_ > 0) {
-        for (const_Iterator it = cont.cbegin(); it != cont.cend(); it++, i++) {
-            std::construct_at(data_ + i, *it);
-        }
-    }
-    begin_ = data_;
-    end_ = isFull ? data_ : data_ + size_;
+template<class T, class A, class S>
+CCircularBuffer<T, A, S>& CCircularBuffer<T, A, S>::operator=(CCircularBuffer&& cont) noexcept {
+    CCircularBuffer<T, A, S> temp(std::move(cont));
+    this->swap(temp);
+    return *this;
 }
 
-template<class T, class A>
-CCircularBuffer<T, A>::CCircularBuffer(const std::initializer_list<T> &il) :
-        data_(alloc.allocate(il.size())),
+template<class T, class A, class S>
+CCircularBuffer<T, A, S>::CCircularBuffer(const std::initializer_list<T> &il) :
+        data_(alloc.allocate(il.size())), head_(0),
         size_(il.size()), capacity_(il.size()),
-        begin_(data_), end_(data_), isFull(true){
+        mask_(capacity_ - 1), pow2_(false), inline_(nullptr), inlineCapacity_(0) {
             size_t i = 0;
             for (auto it = il.begin(); it != il.end(); i++, it++) {
                 std::construct_at(data_ + i, *it);
             }
+            stats_.replaced(size_);
 }
 
-template<class T, class A>
+template<class T, class A, class S>
 template<std::forward_iterator iter>
-CCircularBuffer<T, A>::CCircularBuffer(iter it1, iter it2): data_(alloc.allocate(it2 - it1)),
-                                                            size_(it2 - it1), capacity_(it2 - it1),
-                                                            begin_(data_), end_(data_), isFull(true){
+CCircularBuffer<T, A, S>::CCircularBuffer(iter it1, iter it2): data_(alloc.allocate(std::distance(it1, it2))), head_(0),
+                                                            size_(std::distance(it1, it2)), capacity_(size_),
+                                                            mask_(capacity_ - 1), pow2_(false), inline_(nullptr), inlineCapacity_(0) {
     size_t i = 0;
     for (auto it = it1; it != it2; i++, it++) {
         std::construct_at(data_ + i, *it);
     }
+    stats_.replaced(size_);
 }
 
-template<class T, class A>
-CCircularBuffer<T, A>::CCircularBuffer(): data_ (0), size_(0), capacity_(0), begin_(0), end_(0), isFull(true){}
+template<class T, class A, class S>
+CCircularBuffer<T, A, S>::CCircularBuffer(): data_(nullptr), head_(0), size_(0), capacity_(0), mask_(0), pow2_(false), inline_(nullptr), inlineCapacity_(0) {}
 
-template<class T, class A>
-CCircularBuffer<T, A>::CCircularBuffer(const size_t size): size_(size), capacity_(size), data_(alloc.allocate(size)),
-                                                           begin_(data_), end_(data_), isFull(false){
+template<class T, class A, class S>
+CCircularBuffer<T, A, S>::CCircularBuffer(const size_t size): data_(alloc.allocate(size)), head_(0), size_(size),
+                                                           capacity_(size), mask_(size - 1), pow2_(false), inline_(nullptr), inlineCapacity_(0) {
     for (size_t i = 0; i < capacity_; i++) {
         std::construct_at(data_ + i, T());
     }
+    stats_.replaced(size_);
 }
 
-template<class T, class A>
-CCircularBuffer<T, A>::CCircularBuffer(const size_t size, const T value): size_(size), capacity_(size), data_(alloc.allocate(capacity_)),
-                                                                          begin_(data_), end_(data_), isFull(true){
+template<class T, class A, class S>
+CCircularBuffer<T, A, S>::CCircularBuffer(const size_t size, const T& value): data_(alloc.allocate(size)), head_(0), size_(size),
+                                                                           capacity_(size), mask_(size - 1), pow2_(false), inline_(nullptr), inlineCapacity_(0) {
     for (size_t i = 0; i < size; i++) {
         std::construct_at(data_ + i, value);
     }
-};
+    stats_.replaced(size_);
+}
 
-template<class T, class A>
-CCircularBuffer<T, A>::~CCircularBuffer(){
-    if (capacity_ != 0) {
-        for (size_t i = 0; i < capacity_; i++) {
-            std::destroy_at(data_ + i);
-        }
-        alloc.deallocate(data_, capacity_);
-    }
+template<class T, class A, class S>
+CCircularBuffer<T, A, S>::CCircularBuffer(const size_t capacity, CPow2Capacity): data_(nullptr), head_(0), size_(0),
+                                                                              capacity_(0), mask_(0), pow2_(true), inline_(nullptr), inlineCapacity_(0) {
+    reserve(capacity);
 }
 
-template<class T, class A>
-void CCircularBuffer<T, A>::swap(CCircularBuffer& b) {
-    T* temp1 = data_;
-    data_ = b.data_;
-    b.data_ = temp1;
+template<class T, class A, class S>
+CCircularBuffer<T, A, S>::~CCircularBuffer(){
+    if (data_ != nullptr) {
+        clear();
+        release();
+    }
+}
 
-    size_t temp = size_;
-    size_ = b.size_;
-    b.size_ = temp;
+template<class T, class A, class S>
+CCircularBuffer<T, A, S>::CCircularBuffer(T* inlineData, size_t inlineCapacity, bool pow2): data_(inlineData), head_(0),
+        size_(0), pow2_(pow2), inline_(inlineData), inlineCapacity_(inlineCapacity), full_(CFullPolicy::Grow) {
+    capacity_ = inline_capacity();
+    mask_ = capacity_ - 1;
+}
 
-    temp = capacity_;
-    capacity_ = b.capacity_;
-    b.capacity_ = temp;
+template<class T, class A, class S>
+bool CCircularBuffer<T, A, S>::is_inline() const {
+    return inline_ != nullptr && data_ == inline_;
+}
 
-    T* temp2 = begin_;
-    begin_ = b.begin_;
-    b.begin_ = temp2;
+// In power-of-two mode only the largest power of two that fits is usable.
+template<class T, class A, class S>
+size_t CCircularBuffer<T, A, S>::inline_capacity() const {
+    if (inline_ == nullptr) {
+        return 0;
+    }
+    return pow2_ ? std::bit_floor(inlineCapacity_) : inlineCapacity_;
+}
 
-    T* temp3 = end_;
-    end_ = b.end_;
-    b.end_ = temp3;
+// Frees the heap block; the elements must already be destroyed or relocated.
+template<class T, class A, class S>
+void CCircularBuffer<T, A, S>::release() {
+    if (data_ != nullptr && !is_inline()) {
+        std::allocator_traits<A>::deallocate(alloc, data_, capacity_);
+    }
+}
 
-    isFull = size_ == capacity_;
-    b.isFull = b.size_ == b.capacity_;
+template<class T, class A, class S>
+void CCircularBuffer<T, A, S>::swap(CCircularBuffer& b) {
+    std::swap(alloc, b.alloc);
+    std::swap(data_, b.data_);
+    std::swap(head_, b.head_);
+    std::swap(size_, b.size_);
+    std::swap(capacity_, b.capacity_);
+    std::swap(mask_, b.mask_);
+    std::swap(pow2_, b.pow2_);
+    std::swap(full_, b.full_);
+    // the statistics policies stay with their objects and only learn that the contents changed
+    stats_.replaced(size_);
+    b.stats_.replaced(b.size_);
 }
 
-template<class T, class A>
-void swap(CCircularBuffer<T, A>& a, CCircularBuffer<T, A>& b) {
+template<class T, class A, class S>
+void swap(CCircularBuffer<T, A, S>& a, CCircularBuffer<T, A, S>& b) {
     a.swap(b);
 }
 
-template<class T, class A>
-bool CCircularBuffer<T, A>::empty() const {
-    return size_ == 0;
+template<class T, class A, class S>
+void CCircularBuffer<T, A, S>::set_full_policy(CFullPolicy policy) {
+    full_ = policy;
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::Iterator CCircularBuffer<T, A>::begin() {
-    return Iterator(begin_, this, true);
+template<class T, class A, class S>
+CFullPolicy CCircularBuffer<T, A, S>::full_policy() const {
+    return full_;
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::Iterator CCircularBuffer<T, A>::begin() const {
-    return Iterator(begin_, this, true);
+template<class T, class A, class S>
+typename CCircularBuffer<T, A, S>::size_type CCircularBuffer<T, A, S>::overwritten() const {
+    return overwritten_;
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::const_Iterator CCircularBuffer<T, A>::cbegin() const {
-    return const_Iterator(begin_, this, true);
+template<class T, class A, class S>
+typename CCircularBuffer<T, A, S>::size_type CCircularBuffer<T, A, S>::dropped() const {
+    return dropped_;
 }
 
-template<class T, class A>
-T& CCircularBuffer<T, A>::front()  {
-    return *begin_;
+template<class T, class A, class S>
+void CCircularBuffer<T, A, S>::reset_counters() {
+    overwritten_ = 0;
+    dropped_ = 0;
+    stats_.reset();
 }
 
-template<class T, class A>
-const T& CCircularBuffer<T, A>::front() const {
-    return *begin_;
+template<class T, class A, class S>
+CBufferStats CCircularBuffer<T, A, S>::stats() const {
+    return stats_.snapshot();
 }
 
-template<class T, class A>
-T& CCircularBuffer<T, A>::back()  {
-    return *(end() - 1);
+template<class T, class A, class S>
+const S& CCircularBuffer<T, A, S>::stats_policy() const {
+    return stats_;
 }
 
-template<class T, class A>
-const T& CCircularBuffer<T, A>::back() const {
-    return *(end() - 1);
+template<class T, class A, class S>
+bool CCircularBuffer<T, A, S>::empty() const {
+    return size_ == 0;
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::Iterator CCircularBuffer<T, A>::end()  {
-    return Iterator(end_, this, false, true);
+template<class T, class A, class S>
+typename CCircularBuffer<T, A, S>::Iterator CCircularBuffer<T, A, S>::begin() {
+    return Iterator(this, 0);
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::Iterator CCircularBuffer<T, A>::end() const {
-    return Iterator(end_, this, false, true);
+template<class T, class A, class S>
+typename CCircularBuffer<T, A, S>::const_Iterator CCircularBuffer<T, A, S>::begin() const {
+    return const_Iterator(this, 0);
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::const_Iterator CCircularBuffer<T, A>::cend() const {
-    return const_Iterator(end_, this, false, true);
+template<class T, class A, class S>
+typename CCircularBuffer<T, A, S>::const_Iterator CCircularBuffer<T, A, S>::cbegin() const {
+    return const_Iterator(this, 0);
 }
 
-
-template<class T, class A>
-typename CCircularBuffer<T, A>::size_type CCircularBuffer<T, A>::size() const {
-    return size_;
+template<class T, class A, class S>
+T& CCircularBuffer<T, A, S>::front()  {
+    return *slot(0);
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::size_type CCircularBuffer<T, A>::capacity() const {
-    return capacity_;
+template<class T, class A, class S>
+const T& CCircularBuffer<T, A, S>::front() const {
+    return *slot(0);
 }
 
-template<class T, class A>
-T& CCircularBuffer<T, A>::operator[](size_type index) {
-    return *(begin() + index);
+template<class T, class A, class S>
+T& CCircularBuffer<T, A, S>::back()  {
+    return *slot(size_ - 1);
 }
 
-template<class T, class A>
-const T& CCircularBuffer<T, A>::operator[](size_type index) const {
-    return *(begin() + index);
+template<class T, class A, class S>
+const T& CCircularBuffer<T, A, S>::back() const {
+    return *slot(size_ - 1);
 }
 
-
-template<class T, class A>
-bool operator==(const CCircularBuffer<T, A> &cont1, const CCircularBuffer<T, A> &cont2) {
-    return (cont1.size() == cont2.size() && std::equal(cont1.begin(), cont1.end(), cont2.begin()));
+template<class T, class A, class S>
+typename CCircularBuffer<T, A, S>::Iterator CCircularBuffer<T, A, S>::end()  {
+    return Iterator(this, size_);
 }
 
-template<class T, class A>
-bool CCircularBuffer<T, A>::Iterator::operator==(Iterator const& other) const {
-    if (!(isBegin && other.isEnd || isEnd && other.isBegin)) {
-        return point == other.point;
-    }
-    return false;
+template<class T, class A, class S>
+typename CCircularBuffer<T, A, S>::const_Iterator CCircularBuffer<T, A, S>::end() const {
+    return const_Iterator(this, size_);
 }
 
-template<class T, class A>
-bool CCircularBuffer<T, A>::Iterator::operator!=(Iterator const& other) const {
-    if (!(isBegin && other.isEnd || isEnd && other.isBegin)) {
-        return point != other.point;
-    }
-    return true;
+template<class T, class A, class S>
+typename CCircularBuffer<T, A, S>::const_Iterator CCircularBuffer<T, A, S>::cend() const {
+    return const_Iterator(this, size_);
 }
 
-template<class T, class A>
-bool CCircularBuffer<T, A>::Iterator::operator<(const Iterator& it) const {
-    return linearize() - it.linearize() < 0;
+template<class T, class A, class S>
+typename CCircularBuffer<T, A, S>::reverse_iterator CCircularBuffer<T, A, S>::rbegin() {
+    return reverse_iterator(end());
 }
 
-template<class T, class A>
-bool CCircularBuffer<T, A>::Iterator::operator>(const Iterator& it) const {
-    return linearize() - it.linearize() > 0;
+template<class T, class A, class S>
+typename CCircularBuffer<T, A, S>::const_reverse_iterator CCircularBuffer<T, A, S>::rbegin() const {
+    return const_reverse_iterator(end());
 }
 
-template<class T, class A>
-bool CCircularBuffer<T, A>::Iterator::operator>=(const Iterator& it) const {
-    return !(*this < it);
+template<class T, class A, class S>
+typename CCircularBuffer<T, A, S>::const_reverse_iterator CCircularBuffer<T, A, S>::crbegin() const {
+    return const_reverse_iterator(cend());
 }
 
-template<class T, class A>
-bool CCircularBuffer<T, A>::Iterator::operator<=(const Iterator& it) const {
-    return !(*this > it);
+template<class T, class A, class S>
+typename CCircularBuffer<T, A, S>::reverse_iterator CCircularBuffer<T, A, S>::rend() {
+    return reverse_iterator(begin());
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::Iterator::pointer CCircularBuffer<T, A>::Iterator::operator->() const {
-    return point;
+template<class T, class A, class S>
+typename CCircularBuffer<T, A, S>::const_reverse_iterator CCircularBuffer<T, A, S>::rend() const {
+    return const_reverse_iterator(begin());
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::Iterator::reference CCircularBuffer<T, A>::Iterator::operator*() const {
-    return *point;
+template<class T, class A, class S>
+typename CCircularBuffer<T, A, S>::const_reverse_iterator CCircularBuffer<T, A, S>::crend() const {
+    return const_reverse_iterator(cbegin());
 }
 
-template<class T, class A>
-CCircularBuffer<T, A>::Iterator::Iterator(T* p, CCircularBuffer<T, A>* cont, bool isbeg, bool isend): point(p), cont_(cont), isBegin(isbeg), isEnd(isend){}
-template<class T, class A>
-CCircularBuffer<T, A>::Iterator::Iterator(const Iterator& it): point(it.point), cont_(it.cont_), isBegin(it.isBegin), isEnd(it.isEnd){}
-
-template<class T, class A>
-CCircularBuffer<T, A>::const_Iterator::const_Iterator(T* p, const CCircularBuffer<T, A>* cont, bool isbeg, bool isend): point(p), cont_(cont), isBegin(isbeg), isEnd(isend){}
-template<class T, class A>
-CCircularBuffer<T, A>::const_Iterator::const_Iterator(const const_Iterator& it): point(it.point), cont_(it.cont_), isBegin(it.isBegin), isEnd(it.isEnd){}
-template<class T, class A>
-CCircularBuffer<T, A>::const_Iterator::const_Iterator(const Iterator& it): point(it.point), cont_(it.cont_), isBegin(it.isBegin), isEnd(it.isEnd){}
-
-template<class T, class A>
-bool CCircularBuffer<T, A>::const_Iterator::operator==(const const_Iterator& other) const {
-    if (!(isBegin && other.isEnd || isEnd && other.isBegin)) {
-        return point == other.point;
-    }
-    return false;
-}
 
-template<class T, class A>
-bool CCircularBuffer<T, A>::const_Iterator::operator!=(const const_Iterator& other) const {
-    if (!(isBegin && other.isEnd || isEnd && other.isBegin)) {
-        return point != other.point;
-    }
-    return true;
+template<class T, class A, class S>
+typename CCircularBuffer<T, A, S>::size_type CCircularBuffer<T, A, S>::size() const {
+    return size_;
 }
 
-template<class T, class A>
-bool CCircularBuffer<T, A>::const_Iterator::operator<(const const_Iterator& it) const {
-    return linearize() - it.linearize() < 0;
+template<class T, class A, class S>
+typename CCircularBuffer<T, A, S>::size_type CCircularBuffer<T, A, S>::capacity() const {
+    return capacity_;
 }
 
-template<class T, class A>
-bool CCircularBuffer<T, A>::const_Iterator::operator>(const const_Iterator& it) const {
-    return linearize() - it.linearize() > 0;
+template<class T, class A, class S>
+T& CCircularBuffer<T, A, S>::operator[](size_type index) {
+    return *slot(index);
 }
 
-template<class T, class A>
-bool CCircularBuffer<T, A>::const_Iterator::operator>=(const const_Iterator& it) const {
-    return !(*this < it);
+template<class T, class A, class S>
+const T& CCircularBuffer<T, A, S>::operator[](size_type index) const {
+    return *slot(index);
 }
 
-template<class T, class A>
-bool CCircularBuffer<T, A>::const_Iterator::operator<=(const const_Iterator& it) const {
-    return !(*this > it);
+template<class T, class A, class S>
+size_t CCircularBuffer<T, A, S>::wrap(size_t i) const {
+    return pow2_ ? i & mask_ : (i < capacity_ ? i : i - capacity_);
 }
 
-template<class T, class A>
-const typename CCircularBuffer<T, A>::const_Iterator::pointer CCircularBuffer<T, A>::const_Iterator::operator->() const {
-    return point;
+template<class T, class A, class S>
+T* CCircularBuffer<T, A, S>::slot(size_t i) const {
+    return data_ + wrap(head_ + i);
 }
 
-template<class T, class A>
-const typename CCircularBuffer<T, A>::const_Iterator::reference CCircularBuffer<T, A>::const_Iterator::operator*(){
-    return *point;
+template<class T, class A, class S>
+std::span<T> CCircularBuffer<T, A, S>::array_one() {
+    return std::span<T>(data_ + head_, std::min(size_, capacity_ - head_));
 }
 
-template<class T, class A>
-typename CCircularBuffer<T, A>::const_Iterator::reference CCircularBuffer<T, A>::const_Iterator::operator*() const { //TODO
-    return *point;
+template<class T, class A, class S>
+std::span<T> CCircularBuffer<T, A, S>::array_two() {
+    return std::span<T>(data_, size_ - array_one().size());
 }
 
-template<class T, class A>
-T* CCircularBuffer<T, A>::const_Iterator::add(T* p, difference_type n) const {
-    return p + (n < (cont_->data_ + cont_->capacity_ - p) ? n : n - cont_->capacity_);
+template<class T, class A, class S>
+std::span<const T> CCircularBuffer<T, A, S>::array_one() const {
+    return std::span<const T>(data_ + head_, std::min(size_, capacity_ - head_));
 }
 
-template<class T, class A>
-T* CCircularBuffer<T, A>::const_Iterator::sub(T* p, difference_type n) const {
-    return p - (n > (p - cont_->data_) ? n - cont_->capacity_ : n);
+template<class T, class A, class S>
+std::span<const T> CCircularBuffer<T, A, S>::array_two() const {
+    return std::span<const T>(data_, size_ - array_one().size());
 }
 
-template<class T, class A>
-T* CCircularBuffer<T, A>::Iterator::add(T* p, difference_type n) const {
-    return p + (n < (cont_->data_ + cont_->capacity_ - p) ? n : n - cont_->capacity_);
+template<class T, class A, class S>
+bool operator==(const CCircularBuffer<T, A, S> &cont1, const CCircularBuffer<T, A, S> &cont2) {
+    return (cont1.size() == cont2.size() && std::equal(cont1.begin(), cont1.end(), cont2.begin()));
 }
 
-template<class T, class A>
-T* CCircularBuffer<T, A>::Iterator::sub(T* p, difference_type n) const {
-    return p - (n > (p - cont_->data_) ? n - cont_->capacity_ : n);
-}
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <thread>
+#include <utility>
+
+#include "notext.h"
+
+// Fork-join versions of for_each, transform_reduce and sort for large buffers.
+// The logical range is cut into one part per thread; a cut is moved back to the nearest
+// cache-line boundary in memory so that no two threads write to the same line, and every
+// part is handed to its thread as at most two raw spans split at the wrap point, so the hot
+// loops never touch the buffer's iterators. The calling thread runs the first part itself.
+// threads == 0 uses std::thread::hardware_concurrency(); parts are never smaller than minPart
+// elements, so small buffers are processed by the calling thread alone.
+// An exception thrown by any part is rethrown by the call once all threads have finished.
+class CCircularBufferParallel {
+public:
+    static constexpr size_t minPart = 1 << 14;
+
+    template<class T, class A, class S, class F>
+    static void for_each(CCircularBuffer<T, A, S>& cont, F f, size_t threads = 0);
+    // Partial results are combined in logical order, so reduce needs to be associative but not commutative.
+    template<class T, class A, class S, class R, class Reduce, class Transform>
+    static R transform_reduce(const CCircularBuffer<T, A, S>& cont, R init, Reduce reduce, Transform transform,
+                              size_t threads = 0);
+    // Sorts every part in place, then merges neighbouring parts pairwise in parallel.
+    template<class T, class A, class S, class Compare = std::less<>>
+    static void sort(CCircularBuffer<T, A, S>& cont, Compare comp = {}, size_t threads = 0);
+
+protected:
+    static constexpr size_t cacheLine = 64;
+
+    template<class U>
+    struct Part {
+        std::span<U> one;
+        std::span<U> two;
+        size_t begin;
+        size_t end;
+    };
+
+    template<class U>
+    static std::unique_ptr<Part<U>[]> partition(std::span<U> one, std::span<U> two, size_t threads, size_t& parts);
+    template<class U>
+    static size_t align(std::span<U> one, std::span<U> two, size_t cut);
+    template<class F>
+    static void run(size_t tasks, const F& f);
+
+    // Joins every started thread when it goes out of scope, so that a failure to start
+    // one of them does not leave the others joinable.
+    struct Joiner {
+        std::thread* threads;
+        size_t count;
+
+        ~Joiner();
+    };
+};
+
+inline CCircularBufferParallel::Joiner::~Joiner() {
+    for (size_t j = 0; j < count; j++) {
+        if (threads[j].joinable()) {
+            threads[j].join();
+        }
+    }
+}
+
+// Moves a logical cut back so that the element after it starts a cache line;
+// a cut never moves across the wrap point, which is a boundary of its own.
+template<class U>
+size_t CCircularBufferParallel::align(std::span<U> one, std::span<U> two, size_t cut) {
+    if constexpr (cacheLine % sizeof(U) != 0) {
+        return cut;
+    } else {
+        bool wrapped = cut >= one.size();
+        U* p = wrapped ? two.data() + (cut - one.size()) : one.data() + cut;
+        size_t back = reinterpret_cast<uintptr_t>(p) % cacheLine / sizeof(U);
+        if (wrapped && cut - back < one.size()) {
+            return one.size();
+        }
+        return cut - back;
+    }
+}
+
+template<class U>
+std::unique_ptr<CCircularBufferParallel::Part<U>[]> CCircularBufferParallel::partition(std::span<U> one, std::span<U> two,
+                                                                                       size_t threads, size_t& parts) {
+    size_t n = one.size() + two.size();
+    if (threads == 0) {
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    parts = std::max<size_t>(std::min(threads, n / minPart), 1);
+    std::unique_ptr<Part<U>[]> result(new Part<U>[parts]);
+    size_t begin = 0;
+    for (size_t j = 0; j < parts; j++) {
+        size_t end = j + 1 == parts ? n : align(one, two, n / parts * (j + 1));
+        size_t splitBegin = std::min(begin, one.size());
+        size_t splitEnd = std::min(end, one.size());
+        result[j].one = one.subspan(splitBegin, splitEnd - splitBegin);
+        result[j].two = two.subspan(begin - splitBegin, end - splitEnd - (begin - splitBegin));
+        result[j].begin = begin;
+        result[j].end = end;
+        begin = end;
+    }
+    return result;
+}
+
+template<class F>
+void CCircularBufferParallel::run(size_t tasks, const F& f) {
+    std::unique_ptr<std::exception_ptr[]> errors(new std::exception_ptr[tasks]);
+    std::unique_ptr<std::thread[]> workers(new std::thread[tasks]);
+    {
+        Joiner joiner {workers.get(), tasks};
+        for (size_t j = 1; j < tasks; j++) {
+            workers[j] = std::thread([&f, &errors, j] {
+                try {
+                    f(j);
+                } catch (...) {
+                    errors[j] = std::current_exception();
+                }
+            });
+        }
+        try {
+            f(0);
+        } catch (...) {
+            errors[0] = std::current_exception();
+        }
+    }
+    for (size_t j = 0; j < tasks; j++) {
+        if (errors[j]) {
+            std::rethrow_exception(errors[j]);
+        }
+    }
+}
+
+template<class T, class A, class S, class F>
+void CCircularBufferParallel::for_each(CCircularBuffer<T, A, S>& cont, F f, size_t threads) {
+    size_t parts;
+    std::unique_ptr<Part<T>[]> part = partition(cont.array_one(), cont.array_two(), threads, parts);
+    run(parts, [&](size_t j) {
+        for (T& value : part[j].one) {
+            f(value);
+        }
+        for (T& value : part[j].two) {
+            f(value);
+        }
+    });
+}
+
+template<class T, class A, class S, class R, class Reduce, class Transform>
+R CCircularBufferParallel::transform_reduce(const CCircularBuffer<T, A, S>& cont, R init, Reduce reduce,
+                                            Transform transform, size_t threads) {
+    size_t parts;
+    std::unique_ptr<Part<const T>[]> part = partition(cont.array_one(), cont.array_two(), threads, parts);
+    std::unique_ptr<std::optional<R>[]> partial(new std::optional<R>[parts]);
+    run(parts, [&](size_t j) {
+        std::optional<R>& result = partial[j];
+        for (std::span<const T> span : {part[j].one, part[j].two}) {
+            for (const T& value : span) {
+                if (result) {
+                    result.emplace(reduce(std::move(*result), transform(value)));
+                } else {
+                    result.emplace(transform(value));
+                }
+            }
+        }
+    });
+    for (size_t j = 0; j < parts; j++) {
+        if (partial[j]) {
+            init = reduce(std::move(init), std::move(*partial[j]));
+        }
+    }
+    return init;
+}
+
+// Parts are sorted as raw spans; only the merges, which cross the wrap point or join
+// parts, go through the buffer's iterators.
+template<class T, class A, class S, class Compare>
+void CCircularBufferParallel::sort(CCircularBuffer<T, A, S>& cont, Compare comp, size_t threads) {
+    size_t parts;
+    std::unique_ptr<Part<T>[]> part = partition(cont.array_one(), cont.array_two(), threads, parts);
+    auto begin = cont.begin();
+    run(parts, [&](size_t j) {
+        std::sort(part[j].one.begin(), part[j].one.end(), comp);
+        std::sort(part[j].two.begin(), part[j].two.end(), comp);
+        if (!part[j].one.empty() && !part[j].two.empty()) {
+            std::inplace_merge(begin + part[j].begin, begin + (part[j].begin + part[j].one.size()), begin + part[j].end, comp);
+        }
+    });
+    for (size_t width = 1; width < parts; width *= 2) {
+        run((parts + 2 * width - 1) / (2 * width), [&](size_t k) {
+            size_t mid = 2 * k * width + width;
+            if (mid >= parts) {
+                return;
+            }
+            size_t last = std::min(mid + width, parts) - 1;
+            std::inplace_merge(begin + part[2 * k * width].begin, begin + part[mid].begin, begin + part[last].end, comp);
+        });
+    }
+}
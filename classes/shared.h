@@ -0,0 +1,285 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <typeinfo>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Ring for one producer and one consumer that may live in different processes.
+// The header (layout description and both indices) and the slots are placed in a POSIX
+// shared-memory segment, so the ring holds no pointers: indices grow without bound and
+// are mapped to slots with a mask. One process create()s the segment, the other attach()es
+// to it by name; attach() throws if the segment was created for a different element type.
+// Besides size and alignment the header records a type tag: by default a hash of the mangled
+// name of T, which matches between programs built with compilers sharing an ABI. Programs that
+// cannot rely on that pass the same tag of their own to create() and attach().
+template<class T>
+class CCircularBufferShared {
+    static_assert(std::is_trivially_copyable_v<T>, "elements are copied between processes as raw bytes");
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "indices must be lock-free to be shared");
+
+public:
+    typedef size_t size_type;
+
+    static uint64_t default_tag();
+    static CCircularBufferShared create(const char* name, size_t capacity, uint64_t tag = default_tag());
+    static CCircularBufferShared attach(const char* name, uint64_t tag = default_tag());
+    // Removes the name; mappings that are already open stay valid.
+    static void remove(const char* name);
+
+    CCircularBufferShared(const CCircularBufferShared&) = delete;
+    CCircularBufferShared(CCircularBufferShared&& cont) noexcept;
+    CCircularBufferShared& operator=(const CCircularBufferShared&) = delete;
+    CCircularBufferShared& operator=(CCircularBufferShared&& cont) noexcept;
+
+    ~CCircularBufferShared();
+
+    // producer side
+    bool try_push(const T& value);
+    size_t try_push(const T* src, size_t n);
+
+    // consumer side
+    bool try_pop(T& value);
+    size_t try_pop(T* dest, size_t n);
+
+    bool empty() const;
+    size_type size() const;
+    size_type capacity() const;
+
+protected:
+    static constexpr size_t cacheLine = 64;
+    static constexpr uint64_t magic = 0x4369724342756631;
+    static constexpr uint32_t version = 2;
+
+    struct Header {
+        std::atomic<uint64_t> magic;
+        uint32_t version;
+        uint32_t elemSize;
+        uint32_t elemAlign;
+        uint64_t tag;
+        uint64_t capacity;
+        alignas(cacheLine) std::atomic<uint64_t> head;
+        alignas(cacheLine) std::atomic<uint64_t> tail;
+    };
+
+    static constexpr size_t dataOffset = (sizeof(Header) + alignof(T) - 1) / alignof(T) * alignof(T);
+
+    CCircularBufferShared(void* base, size_t bytes);
+    void copy_in(uint64_t pos, const T* src, size_t n);
+    void copy_out(uint64_t pos, T* dest, size_t n) const;
+
+    Header* header_;
+    T* data_;
+    size_t bytes_;
+    uint64_t mask_;
+    uint64_t headCache_;
+    uint64_t tailCache_;
+};
+
+template<class T>
+CCircularBufferShared<T>::CCircularBufferShared(void* base, size_t bytes): header_(static_cast<Header*>(base)),
+        data_(reinterpret_cast<T*>(static_cast<char*>(base) + dataOffset)), bytes_(bytes),
+        mask_(header_->capacity - 1), headCache_(header_->head.load(std::memory_order_acquire)),
+        tailCache_(header_->tail.load(std::memory_order_acquire)) {
+}
+
+// FNV-1a of typeid(T).name().
+template<class T>
+uint64_t CCircularBufferShared<T>::default_tag() {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (const char* p = typeid(T).name(); *p != '\0'; p++) {
+        hash = (hash ^ static_cast<unsigned char>(*p)) * 0x100000001b3;
+    }
+    return hash;
+}
+
+template<class T>
+CCircularBufferShared<T> CCircularBufferShared<T>::create(const char* name, size_t capacity, uint64_t tag) {
+    capacity = std::bit_ceil(std::max<size_t>(capacity, 1));
+    size_t bytes = dataOffset + capacity * sizeof(T);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "shm_open");
+    }
+    if (ftruncate(fd, bytes) != 0) {
+        int error = errno;
+        close(fd);
+        shm_unlink(name);
+        throw std::system_error(error, std::generic_category(), "ftruncate");
+    }
+    void* base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int error = errno;
+    close(fd);
+    if (base == MAP_FAILED) {
+        shm_unlink(name);
+        throw std::system_error(error, std::generic_category(), "mmap");
+    }
+    Header* header = static_cast<Header*>(base);
+    header->version = version;
+    header->elemSize = sizeof(T);
+    header->elemAlign = alignof(T);
+    header->tag = tag;
+    header->capacity = capacity;
+    std::construct_at(&header->head, 0);
+    std::construct_at(&header->tail, 0);
+    // publishing the magic last tells attach() that the rest of the header is ready
+    std::construct_at(&header->magic, 0);
+    header->magic.store(magic, std::memory_order_release);
+    return CCircularBufferShared(base, bytes);
+}
+
+template<class T>
+CCircularBufferShared<T> CCircularBufferShared<T>::attach(const char* name, uint64_t tag) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "shm_open");
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int error = errno;
+        close(fd);
+        throw std::system_error(error, std::generic_category(), "fstat");
+    }
+    size_t bytes = st.st_size;
+    if (bytes < sizeof(Header)) {
+        close(fd);
+        throw std::runtime_error("CCircularBufferShared: segment is too small");
+    }
+    void* base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int error = errno;
+    close(fd);
+    if (base == MAP_FAILED) {
+        throw std::system_error(error, std::generic_category(), "mmap");
+    }
+    Header* header = static_cast<Header*>(base);
+    const char* problem = nullptr;
+    if (header->magic.load(std::memory_order_acquire) != magic) {
+        problem = "CCircularBufferShared: segment is not an initialized ring";
+    } else if (header->version != version) {
+        problem = "CCircularBufferShared: version mismatch";
+    } else if (header->elemSize != sizeof(T) || header->elemAlign != alignof(T)) {
+        problem = "CCircularBufferShared: element layout mismatch";
+    } else if (header->tag != tag) {
+        problem = "CCircularBufferShared: element type mismatch";
+    } else if (!std::has_single_bit(header->capacity) || bytes < dataOffset + header->capacity * sizeof(T)) {
+        problem = "CCircularBufferShared: capacity does not match segment size";
+    }
+    if (problem != nullptr) {
+        munmap(base, bytes);
+        throw std::runtime_error(problem);
+    }
+    return CCircularBufferShared(base, bytes);
+}
+
+template<class T>
+void CCircularBufferShared<T>::remove(const char* name) {
+    shm_unlink(name);
+}
+
+template<class T>
+CCircularBufferShared<T>::CCircularBufferShared(CCircularBufferShared&& cont) noexcept: header_(cont.header_),
+        data_(cont.data_), bytes_(cont.bytes_), mask_(cont.mask_), headCache_(cont.headCache_),
+        tailCache_(cont.tailCache_) {
+    cont.header_ = nullptr;
+}
+
+template<class T>
+CCircularBufferShared<T>& CCircularBufferShared<T>::operator=(CCircularBufferShared&& cont) noexcept {
+    std::swap(header_, cont.header_);
+    std::swap(data_, cont.data_);
+    std::swap(bytes_, cont.bytes_);
+    std::swap(mask_, cont.mask_);
+    std::swap(headCache_, cont.headCache_);
+    std::swap(tailCache_, cont.tailCache_);
+    return *this;
+}
+
+template<class T>
+CCircularBufferShared<T>::~CCircularBufferShared() {
+    if (header_ != nullptr) {
+        munmap(header_, bytes_);
+    }
+}
+
+template<class T>
+void CCircularBufferShared<T>::copy_in(uint64_t pos, const T* src, size_t n) {
+    size_t start = pos & mask_;
+    size_t first = std::min<size_t>(n, mask_ + 1 - start);
+    std::memcpy(data_ + start, src, first * sizeof(T));
+    std::memcpy(data_, src + first, (n - first) * sizeof(T));
+}
+
+template<class T>
+void CCircularBufferShared<T>::copy_out(uint64_t pos, T* dest, size_t n) const {
+    size_t start = pos & mask_;
+    size_t first = std::min<size_t>(n, mask_ + 1 - start);
+    std::memcpy(dest, data_ + start, first * sizeof(T));
+    std::memcpy(dest + first, data_, (n - first) * sizeof(T));
+}
+
+template<class T>
+bool CCircularBufferShared<T>::try_push(const T& value) {
+    return try_push(&value, 1) == 1;
+}
+
+template<class T>
+size_t CCircularBufferShared<T>::try_push(const T* src, size_t n) {
+    uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+    if (tail + n - headCache_ > mask_ + 1) {
+        headCache_ = header_->head.load(std::memory_order_acquire);
+    }
+    n = std::min<size_t>(n, mask_ + 1 - (tail - headCache_));
+    if (n != 0) {
+        copy_in(tail, src, n);
+        header_->tail.store(tail + n, std::memory_order_release);
+    }
+    return n;
+}
+
+template<class T>
+bool CCircularBufferShared<T>::try_pop(T& value) {
+    return try_pop(&value, 1) == 1;
+}
+
+template<class T>
+size_t CCircularBufferShared<T>::try_pop(T* dest, size_t n) {
+    uint64_t head = header_->head.load(std::memory_order_relaxed);
+    if (tailCache_ - head < n) {
+        tailCache_ = header_->tail.load(std::memory_order_acquire);
+    }
+    n = std::min<size_t>(n, tailCache_ - head);
+    if (n != 0) {
+        copy_out(head, dest, n);
+        header_->head.store(head + n, std::memory_order_release);
+    }
+    return n;
+}
+
+template<class T>
+bool CCircularBufferShared<T>::empty() const {
+    return size() == 0;
+}
+
+template<class T>
+typename CCircularBufferShared<T>::size_type CCircularBufferShared<T>::size() const {
+    uint64_t head = header_->head.load(std::memory_order_acquire);
+    uint64_t tail = header_->tail.load(std::memory_order_acquire);
+    return tail - head;
+}
+
+template<class T>
+typename CCircularBufferShared<T>::size_type CCircularBufferShared<T>::capacity() const {
+    return mask_ + 1;
+}
@@ -0,0 +1,508 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#include "notext.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define CIRCULAR_BUFFER_AVX2 1
+#define CIRCULAR_BUFFER_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CIRCULAR_BUFFER_AVX2 0
+#endif
+
+#if CIRCULAR_BUFFER_AVX2
+// 8-lane AVX2 operations shared by the float and int32_t kernels; comparisons return a lane bit mask.
+template<class T>
+struct CAvx2Lanes;
+
+template<>
+struct CAvx2Lanes<float> {
+    typedef __m256 reg;
+
+    CIRCULAR_BUFFER_TARGET_AVX2 static reg load(const float* p) {
+        return _mm256_loadu_ps(p);
+    }
+    CIRCULAR_BUFFER_TARGET_AVX2 static reg set1(float value) {
+        return _mm256_set1_ps(value);
+    }
+    CIRCULAR_BUFFER_TARGET_AVX2 static void store(float* p, reg x) {
+        _mm256_storeu_ps(p, x);
+    }
+    CIRCULAR_BUFFER_TARGET_AVX2 static unsigned eq(reg a, reg b) {
+        return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ));
+    }
+    CIRCULAR_BUFFER_TARGET_AVX2 static unsigned gt(reg a, reg b) {
+        return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ));
+    }
+    CIRCULAR_BUFFER_TARGET_AVX2 static reg min(reg a, reg b) {
+        return _mm256_min_ps(a, b);
+    }
+    CIRCULAR_BUFFER_TARGET_AVX2 static reg max(reg a, reg b) {
+        return _mm256_max_ps(a, b);
+    }
+    CIRCULAR_BUFFER_TARGET_AVX2 static reg zero() {
+        return _mm256_setzero_ps();
+    }
+    // Sets the lanes of acc where x is NaN; min and max return their second operand for NaN, so they cannot keep it.
+    CIRCULAR_BUFFER_TARGET_AVX2 static reg mark_nan(reg acc, reg x) {
+        return _mm256_or_ps(acc, _mm256_cmp_ps(x, x, _CMP_UNORD_Q));
+    }
+    CIRCULAR_BUFFER_TARGET_AVX2 static unsigned any(reg x) {
+        return _mm256_movemask_ps(x);
+    }
+};
+
+template<>
+struct CAvx2Lanes<int32_t> {
+    typedef __m256i reg;
+
+    CIRCULAR_BUFFER_TARGET_AVX2 static reg load(const int32_t* p) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    }
+    CIRCULAR_BUFFER_TARGET_AVX2 static reg set1(int32_t value) {
+        return _mm256_set1_epi32(value);
+    }
+    CIRCULAR_BUFFER_TARGET_AVX2 static void store(int32_t* p, reg x) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), x);
+    }
+    CIRCULAR_BUFFER_TARGET_AVX2 static unsigned eq(reg a, reg b) {
+        return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b)));
+    }
+    CIRCULAR_BUFFER_TARGET_AVX2 static unsigned gt(reg a, reg b) {
+        return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(a, b)));
+    }
+    CIRCULAR_BUFFER_TARGET_AVX2 static reg min(reg a, reg b) {
+        return _mm256_min_epi32(a, b);
+    }
+    CIRCULAR_BUFFER_TARGET_AVX2 static reg max(reg a, reg b) {
+        return _mm256_max_epi32(a, b);
+    }
+    CIRCULAR_BUFFER_TARGET_AVX2 static reg zero() {
+        return _mm256_setzero_si256();
+    }
+    CIRCULAR_BUFFER_TARGET_AVX2 static reg mark_nan(reg acc, reg) {
+        return acc;
+    }
+    CIRCULAR_BUFFER_TARGET_AVX2 static unsigned any(reg x) {
+        return _mm256_movemask_ps(_mm256_castsi256_ps(x));
+    }
+};
+#endif
+
+// Scans and reductions over the (at most two) contiguous runs of a CCircularBuffer.
+// float and int32_t buffers go through AVX2 kernels when the CPU has AVX2, checked once at
+// run time; other element types and other CPUs use plain loops over the runs. The compiler may
+// vectorize the integer loops with the baseline instruction set; floating-point sums stay serial,
+// since without -ffast-math it may not reorder the additions.
+// Sums and dot products accumulate in double for floating-point, in int64_t for signed and in uint64_t
+// (wrapping modulo 2^64) for unsigned integer elements, so results may differ from a float accumulation
+// in the last bits.
+class CCircularBufferSimd {
+public:
+    template<class T>
+    using sum_type = std::conditional_t<std::is_floating_point_v<T>, double,
+                                        std::conditional_t<std::is_unsigned_v<T>, uint64_t, int64_t>>;
+
+    template<class T, class A, class S>
+    static typename CCircularBuffer<T, A, S>::const_iterator find(const CCircularBuffer<T, A, S>& cont, T value);
+    // First element greater than threshold.
+    template<class T, class A, class S>
+    static typename CCircularBuffer<T, A, S>::const_iterator find_greater(const CCircularBuffer<T, A, S>& cont, T threshold);
+    template<class T, class A, class S>
+    static size_t count(const CCircularBuffer<T, A, S>& cont, T value);
+    template<class T, class A, class S>
+    static size_t count_greater(const CCircularBuffer<T, A, S>& cont, T threshold);
+    template<class T, class A, class S>
+    static sum_type<T> sum(const CCircularBuffer<T, A, S>& cont);
+    // The buffer must not be empty. NaN propagates: if any element is NaN, both bounds are NaN.
+    template<class T, class A, class S>
+    static std::pair<T, T> min_max(const CCircularBuffer<T, A, S>& cont);
+    // Over the first min(a.size(), b.size()) elements of both buffers.
+    template<class T, class A, class S>
+    static sum_type<T> dot(const CCircularBuffer<T, A, S>& a, const CCircularBuffer<T, A, S>& b);
+
+    static bool has_avx2();
+    // Makes every call take the scalar path; for testing and benchmarking the fallback.
+    static void set_scalar_only(bool scalarOnly);
+
+protected:
+    template<class T>
+    static bool vectorized();
+
+    template<class T, bool greater>
+    static size_t find_run(const T* p, size_t n, T value);
+    template<class T, bool greater>
+    static size_t count_run(const T* p, size_t n, T value);
+    template<class T>
+    static sum_type<T> sum_run(const T* p, size_t n);
+    template<class T>
+    static void min_max_step(T x, T& lo, T& hi);
+    template<class T>
+    static void min_max_run(const T* p, size_t n, T& lo, T& hi);
+    template<class T>
+    static sum_type<T> dot_run(const T* p, const T* q, size_t n);
+
+#if CIRCULAR_BUFFER_AVX2
+    template<class T, bool greater>
+    CIRCULAR_BUFFER_TARGET_AVX2 static size_t avx2_find(const T* p, size_t n, T value);
+    template<class T, bool greater>
+    CIRCULAR_BUFFER_TARGET_AVX2 static size_t avx2_count(const T* p, size_t n, T value);
+    template<class T>
+    CIRCULAR_BUFFER_TARGET_AVX2 static void avx2_min_max(const T* p, size_t n, T& lo, T& hi);
+    CIRCULAR_BUFFER_TARGET_AVX2 static double avx2_sum(const float* p, size_t n);
+    CIRCULAR_BUFFER_TARGET_AVX2 static int64_t avx2_sum(const int32_t* p, size_t n);
+    CIRCULAR_BUFFER_TARGET_AVX2 static double avx2_dot(const float* p, const float* q, size_t n);
+    CIRCULAR_BUFFER_TARGET_AVX2 static int64_t avx2_dot(const int32_t* p, const int32_t* q, size_t n);
+#endif
+
+    static inline std::atomic<bool> scalarOnly_ = false;
+};
+
+inline bool CCircularBufferSimd::has_avx2() {
+#if CIRCULAR_BUFFER_AVX2
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+#else
+    return false;
+#endif
+}
+
+inline void CCircularBufferSimd::set_scalar_only(bool scalarOnly) {
+    scalarOnly_.store(scalarOnly, std::memory_order_relaxed);
+}
+
+template<class T>
+bool CCircularBufferSimd::vectorized() {
+    if constexpr (CIRCULAR_BUFFER_AVX2 && (std::is_same_v<T, float> || std::is_same_v<T, int32_t>)) {
+        return has_avx2() && !scalarOnly_.load(std::memory_order_relaxed);
+    } else {
+        return false;
+    }
+}
+
+template<class T, bool greater>
+size_t CCircularBufferSimd::find_run(const T* p, size_t n, T value) {
+#if CIRCULAR_BUFFER_AVX2
+    if constexpr (std::is_same_v<T, float> || std::is_same_v<T, int32_t>) {
+        if (vectorized<T>()) {
+            return avx2_find<T, greater>(p, n, value);
+        }
+    }
+#endif
+    for (size_t i = 0; i < n; i++) {
+        if (greater ? p[i] > value : p[i] == value) {
+            return i;
+        }
+    }
+    return n;
+}
+
+template<class T, bool greater>
+size_t CCircularBufferSimd::count_run(const T* p, size_t n, T value) {
+#if CIRCULAR_BUFFER_AVX2
+    if constexpr (std::is_same_v<T, float> || std::is_same_v<T, int32_t>) {
+        if (vectorized<T>()) {
+            return avx2_count<T, greater>(p, n, value);
+        }
+    }
+#endif
+    size_t result = 0;
+    for (size_t i = 0; i < n; i++) {
+        result += greater ? p[i] > value : p[i] == value;
+    }
+    return result;
+}
+
+template<class T>
+CCircularBufferSimd::sum_type<T> CCircularBufferSimd::sum_run(const T* p, size_t n) {
+#if CIRCULAR_BUFFER_AVX2
+    if constexpr (std::is_same_v<T, float> || std::is_same_v<T, int32_t>) {
+        if (vectorized<T>()) {
+            return avx2_sum(p, n);
+        }
+    }
+#endif
+    sum_type<T> result = 0;
+    for (size_t i = 0; i < n; i++) {
+        result += p[i];
+    }
+    return result;
+}
+
+// x != x only for NaN, which then replaces both bounds and is never replaced itself.
+template<class T>
+void CCircularBufferSimd::min_max_step(T x, T& lo, T& hi) {
+    lo = x < lo || x != x ? x : lo;
+    hi = hi < x || x != x ? x : hi;
+}
+
+template<class T>
+void CCircularBufferSimd::min_max_run(const T* p, size_t n, T& lo, T& hi) {
+#if CIRCULAR_BUFFER_AVX2
+    if constexpr (std::is_same_v<T, float> || std::is_same_v<T, int32_t>) {
+        if (vectorized<T>()) {
+            avx2_min_max(p, n, lo, hi);
+            return;
+        }
+    }
+#endif
+    for (size_t i = 0; i < n; i++) {
+        min_max_step(p[i], lo, hi);
+    }
+}
+
+template<class T>
+CCircularBufferSimd::sum_type<T> CCircularBufferSimd::dot_run(const T* p, const T* q, size_t n) {
+#if CIRCULAR_BUFFER_AVX2
+    if constexpr (std::is_same_v<T, float> || std::is_same_v<T, int32_t>) {
+        if (vectorized<T>()) {
+            return avx2_dot(p, q, n);
+        }
+    }
+#endif
+    sum_type<T> result = 0;
+    for (size_t i = 0; i < n; i++) {
+        result += sum_type<T>(p[i]) * q[i];
+    }
+    return result;
+}
+
+template<class T, class A, class S>
+typename CCircularBuffer<T, A, S>::const_iterator CCircularBufferSimd::find(const CCircularBuffer<T, A, S>& cont, T value) {
+    std::span<const T> one = cont.array_one();
+    std::span<const T> two = cont.array_two();
+    size_t i = find_run<T, false>(one.data(), one.size(), value);
+    if (i == one.size()) {
+        i += find_run<T, false>(two.data(), two.size(), value);
+    }
+    return cont.begin() + i;
+}
+
+template<class T, class A, class S>
+typename CCircularBuffer<T, A, S>::const_iterator CCircularBufferSimd::find_greater(const CCircularBuffer<T, A, S>& cont, T threshold) {
+    std::span<const T> one = cont.array_one();
+    std::span<const T> two = cont.array_two();
+    size_t i = find_run<T, true>(one.data(), one.size(), threshold);
+    if (i == one.size()) {
+        i += find_run<T, true>(two.data(), two.size(), threshold);
+    }
+    return cont.begin() + i;
+}
+
+template<class T, class A, class S>
+size_t CCircularBufferSimd::count(const CCircularBuffer<T, A, S>& cont, T value) {
+    std::span<const T> one = cont.array_one();
+    std::span<const T> two = cont.array_two();
+    return count_run<T, false>(one.data(), one.size(), value) + count_run<T, false>(two.data(), two.size(), value);
+}
+
+template<class T, class A, class S>
+size_t CCircularBufferSimd::count_greater(const CCircularBuffer<T, A, S>& cont, T threshold) {
+    std::span<const T> one = cont.array_one();
+    std::span<const T> two = cont.array_two();
+    return count_run<T, true>(one.data(), one.size(), threshold) + count_run<T, true>(two.data(), two.size(), threshold);
+}
+
+template<class T, class A, class S>
+CCircularBufferSimd::sum_type<T> CCircularBufferSimd::sum(const CCircularBuffer<T, A, S>& cont) {
+    std::span<const T> one = cont.array_one();
+    std::span<const T> two = cont.array_two();
+    return sum_run(one.data(), one.size()) + sum_run(two.data(), two.size());
+}
+
+template<class T, class A, class S>
+std::pair<T, T> CCircularBufferSimd::min_max(const CCircularBuffer<T, A, S>& cont) {
+    std::span<const T> one = cont.array_one();
+    std::span<const T> two = cont.array_two();
+    T lo = cont.front();
+    T hi = lo;
+    min_max_run(one.data(), one.size(), lo, hi);
+    min_max_run(two.data(), two.size(), lo, hi);
+    return {lo, hi};
+}
+
+// The runs of the two buffers split at different points, so the kernel is called on the
+// up to three pieces over which both sides are contiguous.
+template<class T, class A, class S>
+CCircularBufferSimd::sum_type<T> CCircularBufferSimd::dot(const CCircularBuffer<T, A, S>& a, const CCircularBuffer<T, A, S>& b) {
+    std::span<const T> runsA[2] = {a.array_one(), a.array_two()};
+    std::span<const T> runsB[2] = {b.array_one(), b.array_two()};
+    size_t n = std::min(a.size(), b.size());
+    sum_type<T> result = 0;
+    size_t ra = 0, rb = 0, ia = 0, ib = 0;
+    while (n != 0) {
+        if (ia == runsA[ra].size()) {
+            ra++;
+            ia = 0;
+            continue;
+        }
+        if (ib == runsB[rb].size()) {
+            rb++;
+            ib = 0;
+            continue;
+        }
+        size_t step = std::min({n, runsA[ra].size() - ia, runsB[rb].size() - ib});
+        result += dot_run(runsA[ra].data() + ia, runsB[rb].data() + ib, step);
+        ia += step;
+        ib += step;
+        n -= step;
+    }
+    return result;
+}
+
+#if CIRCULAR_BUFFER_AVX2
+template<class T, bool greater>
+CIRCULAR_BUFFER_TARGET_AVX2 size_t CCircularBufferSimd::avx2_find(const T* p, size_t n, T value) {
+    typedef CAvx2Lanes<T> L;
+    typename L::reg v = L::set1(value);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        unsigned mask = greater ? L::gt(L::load(p + i), v) : L::eq(L::load(p + i), v);
+        if (mask != 0) {
+            return i + std::countr_zero(mask);
+        }
+    }
+    for (; i < n; i++) {
+        if (greater ? p[i] > value : p[i] == value) {
+            return i;
+        }
+    }
+    return n;
+}
+
+template<class T, bool greater>
+CIRCULAR_BUFFER_TARGET_AVX2 size_t CCircularBufferSimd::avx2_count(const T* p, size_t n, T value) {
+    typedef CAvx2Lanes<T> L;
+    typename L::reg v = L::set1(value);
+    size_t result = 0;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        unsigned mask = greater ? L::gt(L::load(p + i), v) : L::eq(L::load(p + i), v);
+        result += std::popcount(mask);
+    }
+    for (; i < n; i++) {
+        result += greater ? p[i] > value : p[i] == value;
+    }
+    return result;
+}
+
+template<class T>
+CIRCULAR_BUFFER_TARGET_AVX2 void CCircularBufferSimd::avx2_min_max(const T* p, size_t n, T& lo, T& hi) {
+    typedef CAvx2Lanes<T> L;
+    size_t i = 0;
+    if (n >= 8) {
+        typename L::reg vlo = L::set1(lo);
+        typename L::reg vhi = L::set1(hi);
+        typename L::reg nans = L::zero();
+        for (; i + 8 <= n; i += 8) {
+            typename L::reg x = L::load(p + i);
+            vlo = L::min(vlo, x);
+            vhi = L::max(vhi, x);
+            nans = L::mark_nan(nans, x);
+        }
+        if (L::any(nans) != 0) {
+            lo = hi = std::numeric_limits<T>::quiet_NaN();
+            return;
+        }
+        // the lanes hold no NaN now; a NaN lo or hi from an earlier run stays, as every comparison with it is false
+        T lanes[8];
+        L::store(lanes, vlo);
+        for (T x : lanes) {
+            lo = x < lo ? x : lo;
+        }
+        L::store(lanes, vhi);
+        for (T x : lanes) {
+            hi = hi < x ? x : hi;
+        }
+    }
+    for (; i < n; i++) {
+        min_max_step(p[i], lo, hi);
+    }
+}
+
+CIRCULAR_BUFFER_TARGET_AVX2 inline double CCircularBufferSimd::avx2_sum(const float* p, size_t n) {
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_loadu_ps(p + i);
+        acc0 = _mm256_add_pd(acc0, _mm256_cvtps_pd(_mm256_castps256_ps128(x)));
+        acc1 = _mm256_add_pd(acc1, _mm256_cvtps_pd(_mm256_extractf128_ps(x, 1)));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+    double result = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    for (; i < n; i++) {
+        result += p[i];
+    }
+    return result;
+}
+
+CIRCULAR_BUFFER_TARGET_AVX2 inline int64_t CCircularBufferSimd::avx2_sum(const int32_t* p, size_t n) {
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(x)));
+        acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(x, 1)));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    int64_t result = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    for (; i < n; i++) {
+        result += p[i];
+    }
+    return result;
+}
+
+CIRCULAR_BUFFER_TARGET_AVX2 inline double CCircularBufferSimd::avx2_dot(const float* p, const float* q, size_t n) {
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_loadu_ps(p + i);
+        __m256 y = _mm256_loadu_ps(q + i);
+        acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(x)),
+                                                 _mm256_cvtps_pd(_mm256_castps256_ps128(y))));
+        acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(x, 1)),
+                                                 _mm256_cvtps_pd(_mm256_extractf128_ps(y, 1))));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+    double result = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    for (; i < n; i++) {
+        result += double(p[i]) * q[i];
+    }
+    return result;
+}
+
+// _mm256_mul_epi32 multiplies the sign-extended low halves of the 64-bit lanes.
+CIRCULAR_BUFFER_TARGET_AVX2 inline int64_t CCircularBufferSimd::avx2_dot(const int32_t* p, const int32_t* q, size_t n) {
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q + i));
+        acc = _mm256_add_epi64(acc, _mm256_mul_epi32(_mm256_cvtepi32_epi64(_mm256_castsi256_si128(x)),
+                                                     _mm256_cvtepi32_epi64(_mm256_castsi256_si128(y))));
+        acc = _mm256_add_epi64(acc, _mm256_mul_epi32(_mm256_cvtepi32_epi64(_mm256_extracti128_si256(x, 1)),
+                                                     _mm256_cvtepi32_epi64(_mm256_extracti128_si256(y, 1))));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    int64_t result = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    for (; i < n; i++) {
+        result += int64_t(p[i]) * q[i];
+    }
+    return result;
+}
+#endif
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+// Lock-free ring for exactly one producer thread and one consumer thread.
+// The producer only writes tail_, the consumer only writes head_; each side keeps
+// a cached copy of the opposite index and reloads it only when the cache says full/empty.
+template<class T, class A = std::allocator<T>>
+class CCircularBufferSPSC {
+public:
+    typedef typename A::size_type size_type;
+
+    CCircularBufferSPSC(const size_t capacity);
+    CCircularBufferSPSC(const CCircularBufferSPSC&) = delete;
+    CCircularBufferSPSC& operator=(const CCircularBufferSPSC&) = delete;
+
+    ~CCircularBufferSPSC();
+
+    // producer side
+    bool try_push(const T& value);
+    template<class... Args>
+    bool try_emplace(Args&&... args);
+
+    // consumer side
+    bool try_pop(T& value);
+    T* front();
+    void pop();
+
+    bool empty() const;
+    size_type size() const;
+    size_type capacity() const;
+
+protected:
+    static constexpr size_t cacheLine = 64;
+
+    size_t next(size_t i) const;
+
+    A alloc;
+    T* data_;
+    size_t capacity_;
+    size_t slots_;
+
+    alignas(cacheLine) std::atomic<size_t> head_;
+    size_t tailCache_;
+
+    alignas(cacheLine) std::atomic<size_t> tail_;
+    size_t headCache_;
+};
+
+template<class T, class A>
+CCircularBufferSPSC<T, A>::CCircularBufferSPSC(const size_t capacity): capacity_(capacity), slots_(capacity + 1),
+                                                                       head_(0), tailCache_(0), tail_(0), headCache_(0) {
+    // one slot always stays free so that head_ == tail_ means empty
+    data_ = alloc.allocate(slots_);
+}
+
+template<class T, class A>
+CCircularBufferSPSC<T, A>::~CCircularBufferSPSC() {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    for (; head != tail; head = next(head)) {
+        std::destroy_at(data_ + head);
+    }
+    alloc.deallocate(data_, slots_);
+}
+
+template<class T, class A>
+size_t CCircularBufferSPSC<T, A>::next(size_t i) const {
+    return i + 1 == slots_ ? 0 : i + 1;
+}
+
+template<class T, class A>
+bool CCircularBufferSPSC<T, A>::try_push(const T& value) {
+    return try_emplace(value);
+}
+
+template<class T, class A>
+template<class... Args>
+bool CCircularBufferSPSC<T, A>::try_emplace(Args&&... args) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t nextTail = next(tail);
+    if (nextTail == headCache_) {
+        headCache_ = head_.load(std::memory_order_acquire);
+        if (nextTail == headCache_) {
+            return false;
+        }
+    }
+    std::construct_at(data_ + tail, std::forward<Args>(args)...);
+    tail_.store(nextTail, std::memory_order_release);
+    return true;
+}
+
+template<class T, class A>
+T* CCircularBufferSPSC<T, A>::front() {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tailCache_) {
+        tailCache_ = tail_.load(std::memory_order_acquire);
+        if (head == tailCache_) {
+            return nullptr;
+        }
+    }
+    return data_ + head;
+}
+
+template<class T, class A>
+void CCircularBufferSPSC<T, A>::pop() {
+    size_t head = head_.load(std::memory_order_relaxed);
+    std::destroy_at(data_ + head);
+    head_.store(next(head), std::memory_order_release);
+}
+
+template<class T, class A>
+bool CCircularBufferSPSC<T, A>::try_pop(T& value) {
+    T* p = front();
+    if (p == nullptr) {
+        return false;
+    }
+    value = std::move(*p);
+    pop();
+    return true;
+}
+
+template<class T, class A>
+bool CCircularBufferSPSC<T, A>::empty() const {
+    return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+}
+
+template<class T, class A>
+typename CCircularBufferSPSC<T, A>::size_type CCircularBufferSPSC<T, A>::size() const {
+    size_t head = head_.load(std::memory_order_acquire);
+    size_t tail = tail_.load(std::memory_order_acquire);
+    return tail >= head ? tail - head : tail + slots_ - head;
+}
+
+template<class T, class A>
+typename CCircularBufferSPSC<T, A>::size_type CCircularBufferSPSC<T, A>::capacity() const {
+    return capacity_;
+}
@@ -0,0 +1,429 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <compare>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <type_traits>
+
+#include "iterator.h"
+
+// Fixed-capacity ring with inline storage: no allocator and no pointer to the elements.
+// The capacity N is a compile-time constant, so wrapping is a mask when N is a power of two
+// and a single compare otherwise; head and size use the smallest integer type that holds N.
+// Behaves like CCircularBuffer with a fixed capacity (a full buffer overwrites) and is usable
+// in constant expressions.
+template<class T, size_t N>
+class CCircularBufferStatic {
+    static_assert(N > 0, "capacity must be positive");
+
+public:
+    typedef ptrdiff_t difference_type;
+    typedef size_t size_type;
+
+    typedef T value_type;
+    typedef T& reference;
+    typedef const T& const_reference;
+
+    template<bool isConst>
+    using BaseIterator = CCircularBufferIterator<CCircularBufferStatic, isConst>;
+    template<class, bool> friend class CCircularBufferIterator;
+
+    typedef BaseIterator<false> Iterator;
+    typedef BaseIterator<true> const_Iterator;
+    typedef Iterator iterator;
+    typedef const_Iterator const_iterator;
+    typedef std::reverse_iterator<Iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_Iterator> const_reverse_iterator;
+
+    // Sources longer than N keep their last N elements.
+    template<std::forward_iterator iter>
+    constexpr CCircularBufferStatic(iter it1, iter it2);
+    constexpr CCircularBufferStatic(const std::initializer_list<T>& il);
+    constexpr CCircularBufferStatic(const CCircularBufferStatic& cont);
+    constexpr CCircularBufferStatic(CCircularBufferStatic&& cont) noexcept(std::is_nothrow_move_constructible_v<T>);
+    constexpr CCircularBufferStatic();
+
+    constexpr ~CCircularBufferStatic() requires std::is_trivially_destructible_v<T> = default;
+    constexpr ~CCircularBufferStatic();
+
+    constexpr CCircularBufferStatic& operator=(const CCircularBufferStatic& cont);
+    constexpr CCircularBufferStatic& operator=(CCircularBufferStatic&& cont) noexcept(std::is_nothrow_move_constructible_v<T>);
+
+    constexpr Iterator begin();
+    constexpr const_Iterator begin() const;
+    constexpr const_Iterator cbegin() const;
+    constexpr T& front();
+    constexpr const T& front() const;
+    constexpr Iterator end();
+    constexpr const_Iterator end() const;
+    constexpr const_Iterator cend() const;
+    constexpr T& back();
+    constexpr const T& back() const;
+
+    constexpr reverse_iterator rbegin();
+    constexpr const_reverse_iterator rbegin() const;
+    constexpr const_reverse_iterator crbegin() const;
+    constexpr reverse_iterator rend();
+    constexpr const_reverse_iterator rend() const;
+    constexpr const_reverse_iterator crend() const;
+
+    constexpr T& operator[](size_type index);
+    constexpr const T& operator[](size_type index) const;
+
+    std::span<T> array_one();
+    std::span<T> array_two();
+    std::span<const T> array_one() const;
+    std::span<const T> array_two() const;
+
+    constexpr void push_front(const T& value);
+    constexpr void push_front(T&& value);
+    template<class... Args>
+    constexpr void emplace_front(Args&&... args);
+    constexpr void pop_front();
+
+    constexpr void push_back(const T& elem);
+    constexpr void push_back(T&& elem);
+    template<class... Args>
+    constexpr void emplace_back(Args&&... args);
+    constexpr void pop_back();
+
+    constexpr void clear();
+    constexpr bool empty() const;
+    constexpr bool full() const;
+    constexpr size_type size() const;
+    static constexpr size_type capacity();
+    static constexpr size_type max_size();
+    constexpr void swap(CCircularBufferStatic& cont);
+
+protected:
+    typedef std::conditional_t<N <= UINT8_MAX, uint8_t,
+            std::conditional_t<N <= UINT16_MAX, uint16_t,
+            std::conditional_t<N <= UINT32_MAX, uint32_t, size_t>>> index_type;
+
+    // A slot is raw storage for one T; the union keeps the element's lifetime manual.
+    union Slot {
+        T value;
+
+        constexpr Slot() {}
+        constexpr ~Slot() requires std::is_trivially_destructible_v<T> = default;
+        constexpr ~Slot() {}
+    };
+
+    static_assert(sizeof(Slot) == sizeof(T), "slots must be laid out like an array of T");
+
+    static constexpr size_t wrap(size_t i);
+    constexpr T* slot(size_t i);
+    constexpr const T* slot(size_t i) const;
+
+    Slot slots_[N];
+    index_type head_;
+    index_type size_;
+};
+
+template<class T, size_t N>
+constexpr size_t CCircularBufferStatic<T, N>::wrap(size_t i) {
+    if constexpr (std::has_single_bit(N)) {
+        return i & (N - 1);
+    } else {
+        return i < N ? i : i - N;
+    }
+}
+
+template<class T, size_t N>
+constexpr T* CCircularBufferStatic<T, N>::slot(size_t i) {
+    return &slots_[wrap(head_ + i)].value;
+}
+
+template<class T, size_t N>
+constexpr const T* CCircularBufferStatic<T, N>::slot(size_t i) const {
+    return &slots_[wrap(head_ + i)].value;
+}
+
+template<class T, size_t N>
+constexpr CCircularBufferStatic<T, N>::CCircularBufferStatic(): head_(0), size_(0) {}
+
+template<class T, size_t N>
+template<std::forward_iterator iter>
+constexpr CCircularBufferStatic<T, N>::CCircularBufferStatic(iter it1, iter it2): head_(0), size_(0) {
+    size_t n = std::distance(it1, it2);
+    if (n > N) {
+        std::advance(it1, n - N);
+    }
+    for (; it1 != it2; it1++) {
+        emplace_back(*it1);
+    }
+}
+
+template<class T, size_t N>
+constexpr CCircularBufferStatic<T, N>::CCircularBufferStatic(const std::initializer_list<T>& il):
+        CCircularBufferStatic(il.begin(), il.end()) {
+}
+
+template<class T, size_t N>
+constexpr CCircularBufferStatic<T, N>::CCircularBufferStatic(const CCircularBufferStatic& cont): head_(0), size_(0) {
+    for (size_t i = 0; i < cont.size_; i++) {
+        emplace_back(*cont.slot(i));
+    }
+}
+
+// The source is left empty, as with CCircularBuffer.
+template<class T, size_t N>
+constexpr CCircularBufferStatic<T, N>::CCircularBufferStatic(CCircularBufferStatic&& cont)
+        noexcept(std::is_nothrow_move_constructible_v<T>): head_(0), size_(0) {
+    for (size_t i = 0; i < cont.size_; i++) {
+        emplace_back(std::move(*cont.slot(i)));
+    }
+    cont.clear();
+}
+
+template<class T, size_t N>
+constexpr CCircularBufferStatic<T, N>::~CCircularBufferStatic() {
+    clear();
+}
+
+template<class T, size_t N>
+constexpr CCircularBufferStatic<T, N>& CCircularBufferStatic<T, N>::operator=(const CCircularBufferStatic& cont) {
+    if (this != &cont) {
+        clear();
+        for (size_t i = 0; i < cont.size_; i++) {
+            emplace_back(*cont.slot(i));
+        }
+    }
+    return *this;
+}
+
+template<class T, size_t N>
+constexpr CCircularBufferStatic<T, N>& CCircularBufferStatic<T, N>::operator=(CCircularBufferStatic&& cont)
+        noexcept(std::is_nothrow_move_constructible_v<T>) {
+    if (this != &cont) {
+        clear();
+        for (size_t i = 0; i < cont.size_; i++) {
+            emplace_back(std::move(*cont.slot(i)));
+        }
+        cont.clear();
+    }
+    return *this;
+}
+
+template<class T, size_t N>
+constexpr typename CCircularBufferStatic<T, N>::Iterator CCircularBufferStatic<T, N>::begin() {
+    return Iterator(this, 0);
+}
+
+template<class T, size_t N>
+constexpr typename CCircularBufferStatic<T, N>::const_Iterator CCircularBufferStatic<T, N>::begin() const {
+    return const_Iterator(this, 0);
+}
+
+template<class T, size_t N>
+constexpr typename CCircularBufferStatic<T, N>::const_Iterator CCircularBufferStatic<T, N>::cbegin() const {
+    return const_Iterator(this, 0);
+}
+
+template<class T, size_t N>
+constexpr T& CCircularBufferStatic<T, N>::front() {
+    return *slot(0);
+}
+
+template<class T, size_t N>
+constexpr const T& CCircularBufferStatic<T, N>::front() const {
+    return *slot(0);
+}
+
+template<class T, size_t N>
+constexpr typename CCircularBufferStatic<T, N>::Iterator CCircularBufferStatic<T, N>::end() {
+    return Iterator(this, size_);
+}
+
+template<class T, size_t N>
+constexpr typename CCircularBufferStatic<T, N>::const_Iterator CCircularBufferStatic<T, N>::end() const {
+    return const_Iterator(this, size_);
+}
+
+template<class T, size_t N>
+constexpr typename CCircularBufferStatic<T, N>::const_Iterator CCircularBufferStatic<T, N>::cend() const {
+    return const_Iterator(this, size_);
+}
+
+template<class T, size_t N>
+constexpr T& CCircularBufferStatic<T, N>::back() {
+    return *slot(size_ - 1);
+}
+
+template<class T, size_t N>
+constexpr const T& CCircularBufferStatic<T, N>::back() const {
+    return *slot(size_ - 1);
+}
+
+template<class T, size_t N>
+constexpr typename CCircularBufferStatic<T, N>::reverse_iterator CCircularBufferStatic<T, N>::rbegin() {
+    return reverse_iterator(end());
+}
+
+template<class T, size_t N>
+constexpr typename CCircularBufferStatic<T, N>::const_reverse_iterator CCircularBufferStatic<T, N>::rbegin() const {
+    return const_reverse_iterator(end());
+}
+
+template<class T, size_t N>
+constexpr typename CCircularBufferStatic<T, N>::const_reverse_iterator CCircularBufferStatic<T, N>::crbegin() const {
+    return const_reverse_iterator(cend());
+}
+
+template<class T, size_t N>
+constexpr typename CCircularBufferStatic<T, N>::reverse_iterator CCircularBufferStatic<T, N>::rend() {
+    return reverse_iterator(begin());
+}
+
+template<class T, size_t N>
+constexpr typename CCircularBufferStatic<T, N>::const_reverse_iterator CCircularBufferStatic<T, N>::rend() const {
+    return const_reverse_iterator(begin());
+}
+
+template<class T, size_t N>
+constexpr typename CCircularBufferStatic<T, N>::const_reverse_iterator CCircularBufferStatic<T, N>::crend() const {
+    return const_reverse_iterator(cbegin());
+}
+
+template<class T, size_t N>
+constexpr T& CCircularBufferStatic<T, N>::operator[](size_type index) {
+    return *slot(index);
+}
+
+template<class T, size_t N>
+constexpr const T& CCircularBufferStatic<T, N>::operator[](size_type index) const {
+    return *slot(index);
+}
+
+template<class T, size_t N>
+std::span<T> CCircularBufferStatic<T, N>::array_one() {
+    return {slot(0), std::min<size_t>(size_, N - head_)};
+}
+
+template<class T, size_t N>
+std::span<T> CCircularBufferStatic<T, N>::array_two() {
+    return {&slots_[0].value, size_ - std::min<size_t>(size_, N - head_)};
+}
+
+template<class T, size_t N>
+std::span<const T> CCircularBufferStatic<T, N>::array_one() const {
+    return {slot(0), std::min<size_t>(size_, N - head_)};
+}
+
+template<class T, size_t N>
+std::span<const T> CCircularBufferStatic<T, N>::array_two() const {
+    return {&slots_[0].value, size_ - std::min<size_t>(size_, N - head_)};
+}
+
+template<class T, size_t N>
+constexpr void CCircularBufferStatic<T, N>::push_front(const T& value) {
+    emplace_front(value);
+}
+
+template<class T, size_t N>
+constexpr void CCircularBufferStatic<T, N>::push_front(T&& value) {
+    emplace_front(std::move(value));
+}
+
+template<class T, size_t N>
+template<class... Args>
+constexpr void CCircularBufferStatic<T, N>::emplace_front(Args&&... args) {
+    if (size_ == N) {
+        T value(std::forward<Args>(args)...);
+        head_ = wrap(head_ + N - 1);
+        slots_[head_].value = std::move(value);
+    } else {
+        std::construct_at(&slots_[wrap(head_ + N - 1)].value, std::forward<Args>(args)...);
+        head_ = wrap(head_ + N - 1);
+        size_++;
+    }
+}
+
+template<class T, size_t N>
+constexpr void CCircularBufferStatic<T, N>::pop_front() {
+    if (size_ == 0) {
+        return;
+    }
+    std::destroy_at(slot(0));
+    head_ = wrap(head_ + 1);
+    size_--;
+}
+
+template<class T, size_t N>
+constexpr void CCircularBufferStatic<T, N>::push_back(const T& elem) {
+    emplace_back(elem);
+}
+
+template<class T, size_t N>
+constexpr void CCircularBufferStatic<T, N>::push_back(T&& elem) {
+    emplace_back(std::move(elem));
+}
+
+template<class T, size_t N>
+template<class... Args>
+constexpr void CCircularBufferStatic<T, N>::emplace_back(Args&&... args) {
+    if (size_ == N) {
+        T value(std::forward<Args>(args)...);
+        slots_[head_].value = std::move(value);
+        head_ = wrap(head_ + 1);
+    } else {
+        std::construct_at(slot(size_), std::forward<Args>(args)...);
+        size_++;
+    }
+}
+
+template<class T, size_t N>
+constexpr void CCircularBufferStatic<T, N>::pop_back() {
+    if (size_ == 0) {
+        return;
+    }
+    size_--;
+    std::destroy_at(slot(size_));
+}
+
+template<class T, size_t N>
+constexpr void CCircularBufferStatic<T, N>::clear() {
+    for (size_t i = 0; i < size_; i++) {
+        std::destroy_at(slot(i));
+    }
+    head_ = 0;
+    size_ = 0;
+}
+
+template<class T, size_t N>
+constexpr bool CCircularBufferStatic<T, N>::empty() const {
+    return size_ == 0;
+}
+
+template<class T, size_t N>
+constexpr bool CCircularBufferStatic<T, N>::full() const {
+    return size_ == N;
+}
+
+template<class T, size_t N>
+constexpr typename CCircularBufferStatic<T, N>::size_type CCircularBufferStatic<T, N>::size() const {
+    return size_;
+}
+
+template<class T, size_t N>
+constexpr typename CCircularBufferStatic<T, N>::size_type CCircularBufferStatic<T, N>::capacity() {
+    return N;
+}
+
+template<class T, size_t N>
+constexpr typename CCircularBufferStatic<T, N>::size_type CCircularBufferStatic<T, N>::max_size() {
+    return N;
+}
+
+template<class T, size_t N>
+constexpr void CCircularBufferStatic<T, N>::swap(CCircularBufferStatic& cont) {
+    CCircularBufferStatic temp(std::move(cont));
+    cont = std::move(*this);
+    *this = std::move(temp);
+}
+
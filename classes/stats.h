@@ -0,0 +1,182 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+
+// Snapshot of the hot-path counters of one buffer.
+// pushes and pops count elements added by push_*, emplace_* and insert and removed by pop_* and erase;
+// a push that overwrites counts both as a push and as an overwrite. maxSize is the largest size() seen.
+// reallocations counts every move to a new block (growth, shrink_to_fit, reserve), with the bytes
+// relocated and the time taken by allocating and relocating.
+struct CBufferStats {
+    uint64_t pushes = 0;
+    uint64_t pops = 0;
+    uint64_t overwrites = 0;
+    uint64_t drops = 0;
+    uint64_t maxSize = 0;
+    uint64_t reserves = 0;
+    uint64_t reallocations = 0;
+    uint64_t bytesRelocated = 0;
+    uint64_t reallocationNanos = 0;
+};
+
+// Statistics policies are the third template argument of CCircularBuffer (the fourth of CCircularBufferExt).
+// The default counts nothing: every hook is empty and the member takes no space, so the hot paths compile
+// exactly as without statistics.
+// The buffer reports every change to its sequence: n elements added at or removed from one end (size is the
+// size afterwards; a push into a full buffer also removes the elements it overwrote from the other end),
+// k elements inserted or erased at logical position pos (an insertion into a full buffer also removes the
+// elements it overwrote from the front, and pos counts without them), and replaced() when the whole contents were
+// replaced without the individual elements passing through the hooks (construction, clear, swap).
+struct CNoStats {
+    struct Timer {};
+
+    void pushed_back(size_t, size_t) {}
+    void pushed_front(size_t, size_t) {}
+    void inserted(size_t, size_t, size_t) {}
+    void popped_front(size_t) {}
+    void popped_back(size_t) {}
+    void erased(size_t, size_t) {}
+    void replaced(size_t) {}
+    void overwrote(size_t) {}
+    void dropped(size_t) {}
+    void reserved() {}
+    Timer start() const {
+        return {};
+    }
+    void reallocated(Timer, size_t) {}
+    void relocated(Timer, size_t) {}
+
+    CBufferStats snapshot() const {
+        return {};
+    }
+    void reset() {}
+};
+
+// Counts into relaxed atomics. Only the thread that owns the buffer writes them, so an update
+// is a plain load and store rather than a locked read-modify-write; stats() may be called
+// from any thread while the owner keeps working and sees each counter at some recent value.
+class CAtomicStats {
+public:
+    typedef std::chrono::steady_clock::time_point Timer;
+
+    void pushed_back(size_t n, size_t size);
+    void pushed_front(size_t n, size_t size);
+    void inserted(size_t pos, size_t k, size_t size);
+    void popped_front(size_t n);
+    void popped_back(size_t n);
+    void erased(size_t pos, size_t k);
+    void replaced(size_t size);
+    void overwrote(size_t n);
+    void dropped(size_t n);
+    void reserved();
+    Timer start() const;
+    // A move to a new block, and a later part of one: incremental growth moves its elements after the switch.
+    void reallocated(Timer started, size_t bytes);
+    void relocated(Timer started, size_t bytes);
+
+    CBufferStats snapshot() const;
+    void reset();
+
+protected:
+    static void add(std::atomic<uint64_t>& counter, uint64_t n);
+    void pushed(size_t n, size_t size);
+
+    std::atomic<uint64_t> pushes_ = 0;
+    std::atomic<uint64_t> pops_ = 0;
+    std::atomic<uint64_t> overwrites_ = 0;
+    std::atomic<uint64_t> drops_ = 0;
+    std::atomic<uint64_t> maxSize_ = 0;
+    std::atomic<uint64_t> reserves_ = 0;
+    std::atomic<uint64_t> reallocations_ = 0;
+    std::atomic<uint64_t> bytesRelocated_ = 0;
+    std::atomic<uint64_t> reallocationNanos_ = 0;
+};
+
+inline void CAtomicStats::add(std::atomic<uint64_t>& counter, uint64_t n) {
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+inline void CAtomicStats::pushed(size_t n, size_t size) {
+    add(pushes_, n);
+    if (size > maxSize_.load(std::memory_order_relaxed)) {
+        maxSize_.store(size, std::memory_order_relaxed);
+    }
+}
+
+inline void CAtomicStats::pushed_back(size_t n, size_t size) {
+    pushed(n, size);
+}
+
+inline void CAtomicStats::pushed_front(size_t n, size_t size) {
+    pushed(n, size);
+}
+
+inline void CAtomicStats::inserted(size_t, size_t k, size_t size) {
+    pushed(k, size);
+}
+
+inline void CAtomicStats::popped_front(size_t n) {
+    add(pops_, n);
+}
+
+inline void CAtomicStats::popped_back(size_t n) {
+    add(pops_, n);
+}
+
+inline void CAtomicStats::erased(size_t, size_t k) {
+    add(pops_, k);
+}
+
+inline void CAtomicStats::replaced(size_t) {}
+
+inline void CAtomicStats::overwrote(size_t n) {
+    add(overwrites_, n);
+}
+
+inline void CAtomicStats::dropped(size_t n) {
+    add(drops_, n);
+}
+
+inline void CAtomicStats::reserved() {
+    add(reserves_, 1);
+}
+
+inline CAtomicStats::Timer CAtomicStats::start() const {
+    return std::chrono::steady_clock::now();
+}
+
+inline void CAtomicStats::reallocated(Timer started, size_t bytes) {
+    add(reallocations_, 1);
+    relocated(started, bytes);
+}
+
+inline void CAtomicStats::relocated(Timer started, size_t bytes) {
+    auto elapsed = std::chrono::steady_clock::now() - started;
+    add(bytesRelocated_, bytes);
+    add(reallocationNanos_, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+inline CBufferStats CAtomicStats::snapshot() const {
+    CBufferStats stats;
+    stats.pushes = pushes_.load(std::memory_order_relaxed);
+    stats.pops = pops_.load(std::memory_order_relaxed);
+    stats.overwrites = overwrites_.load(std::memory_order_relaxed);
+    stats.drops = drops_.load(std::memory_order_relaxed);
+    stats.maxSize = maxSize_.load(std::memory_order_relaxed);
+    stats.reserves = reserves_.load(std::memory_order_relaxed);
+    stats.reallocations = reallocations_.load(std::memory_order_relaxed);
+    stats.bytesRelocated = bytesRelocated_.load(std::memory_order_relaxed);
+    stats.reallocationNanos = reallocationNanos_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+inline void CAtomicStats::reset() {
+    for (std::atomic<uint64_t>* counter : {&pushes_, &pops_, &overwrites_, &drops_, &maxSize_, &reserves_,
+                                           &reallocations_, &bytesRelocated_, &reallocationNanos_}) {
+        counter->store(0, std::memory_order_relaxed);
+    }
+}
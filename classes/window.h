@@ -0,0 +1,203 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+#include "notext.h"
+
+// The last window() samples together with running aggregates, so that every query is O(1).
+// Each push_back evicts the oldest sample once the window is full and updates:
+// - the sum with Neumaier compensated summation (the evicted sample is added negated),
+// - mean and variance with Welford's update and its inverse for the evicted sample,
+// - min and max with monotonic queues of (sample, position) pairs, amortized O(1) per push.
+template<class T, class A = std::allocator<T>>
+class CCircularBufferWindow {
+    static_assert(std::is_arithmetic_v<T>, "window aggregates need arithmetic samples");
+
+    struct Extremum {
+        T value;
+        size_t seq;
+    };
+
+    typedef typename std::allocator_traits<A>::template rebind_alloc<Extremum> ExtremumAlloc;
+
+public:
+    typedef typename A::size_type size_type;
+    typedef T value_type;
+
+    CCircularBufferWindow(const size_t window);
+
+    void push_back(const T& value);
+    void clear();
+
+    bool empty() const;
+    bool full() const;
+    size_type size() const;
+    size_type window() const;
+    const CCircularBuffer<T, A>& samples() const;
+
+    // Undefined on an empty window, like front() of an empty buffer.
+    T min() const;
+    T max() const;
+    double sum() const;
+    double mean() const;
+    // Population variance of the samples in the window; sample_variance() divides by size() - 1.
+    double variance() const;
+    double sample_variance() const;
+    double stddev() const;
+
+protected:
+    void add(double x);
+    void remove(double x);
+    void accumulate(double x);
+
+    CCircularBuffer<T, A> samples_;
+    CCircularBuffer<Extremum, ExtremumAlloc> mins_;
+    CCircularBuffer<Extremum, ExtremumAlloc> maxs_;
+    size_t window_;
+    size_t seq_;
+    double sum_;
+    double compensation_;
+    double mean_;
+    double m2_;
+};
+
+template<class T, class A>
+CCircularBufferWindow<T, A>::CCircularBufferWindow(const size_t window): window_(window), seq_(0), sum_(0),
+                                                                         compensation_(0), mean_(0), m2_(0) {
+    samples_.reserve(window);
+    mins_.reserve(window);
+    maxs_.reserve(window);
+}
+
+template<class T, class A>
+void CCircularBufferWindow<T, A>::accumulate(double x) {
+    double t = sum_ + x;
+    if (std::abs(sum_) >= std::abs(x)) {
+        compensation_ += (sum_ - t) + x;
+    } else {
+        compensation_ += (x - t) + sum_;
+    }
+    sum_ = t;
+}
+
+template<class T, class A>
+void CCircularBufferWindow<T, A>::add(double x) {
+    accumulate(x);
+    size_t n = samples_.size() + 1;
+    double delta = x - mean_;
+    mean_ += delta / n;
+    m2_ += delta * (x - mean_);
+}
+
+template<class T, class A>
+void CCircularBufferWindow<T, A>::remove(double x) {
+    size_t n = samples_.size();
+    if (n == 1) {
+        sum_ = compensation_ = mean_ = m2_ = 0;
+        return;
+    }
+    accumulate(-x);
+    double delta = x - mean_;
+    mean_ -= delta / (n - 1);
+    m2_ = std::max(m2_ - delta * (x - mean_), 0.0);
+}
+
+template<class T, class A>
+void CCircularBufferWindow<T, A>::push_back(const T& value) {
+    if (window_ == 0) {
+        return;
+    }
+    if (samples_.size() == window_) {
+        remove(samples_.front());
+        samples_.pop_front();
+    }
+    add(value);
+    samples_.push_back(value);
+
+    size_t seq = seq_++;
+    while (!mins_.empty() && !(mins_.back().value < value)) {
+        mins_.pop_back();
+    }
+    while (!maxs_.empty() && !(value < maxs_.back().value)) {
+        maxs_.pop_back();
+    }
+    // the fronts are the oldest entries, so at most one of each can have left the window
+    if (!mins_.empty() && mins_.front().seq + window_ <= seq) {
+        mins_.pop_front();
+    }
+    if (!maxs_.empty() && maxs_.front().seq + window_ <= seq) {
+        maxs_.pop_front();
+    }
+    mins_.push_back(Extremum{value, seq});
+    maxs_.push_back(Extremum{value, seq});
+}
+
+template<class T, class A>
+void CCircularBufferWindow<T, A>::clear() {
+    samples_.clear();
+    mins_.clear();
+    maxs_.clear();
+    sum_ = compensation_ = mean_ = m2_ = 0;
+}
+
+template<class T, class A>
+bool CCircularBufferWindow<T, A>::empty() const {
+    return samples_.empty();
+}
+
+template<class T, class A>
+bool CCircularBufferWindow<T, A>::full() const {
+    return samples_.size() == window_;
+}
+
+template<class T, class A>
+typename CCircularBufferWindow<T, A>::size_type CCircularBufferWindow<T, A>::size() const {
+    return samples_.size();
+}
+
+template<class T, class A>
+typename CCircularBufferWindow<T, A>::size_type CCircularBufferWindow<T, A>::window() const {
+    return window_;
+}
+
+template<class T, class A>
+const CCircularBuffer<T, A>& CCircularBufferWindow<T, A>::samples() const {
+    return samples_;
+}
+
+template<class T, class A>
+T CCircularBufferWindow<T, A>::min() const {
+    return mins_.front().value;
+}
+
+template<class T, class A>
+T CCircularBufferWindow<T, A>::max() const {
+    return maxs_.front().value;
+}
+
+template<class T, class A>
+double CCircularBufferWindow<T, A>::sum() const {
+    return sum_ + compensation_;
+}
+
+template<class T, class A>
+double CCircularBufferWindow<T, A>::mean() const {
+    return samples_.empty() ? 0 : sum() / samples_.size();
+}
+
+template<class T, class A>
+double CCircularBufferWindow<T, A>::variance() const {
+    return samples_.empty() ? 0 : m2_ / samples_.size();
+}
+
+template<class T, class A>
+double CCircularBufferWindow<T, A>::sample_variance() const {
+    return samples_.size() < 2 ? 0 : m2_ / (samples_.size() - 1);
+}
+
+template<class T, class A>
+double CCircularBufferWindow<T, A>::stddev() const {
+    return std::sqrt(variance());
+}
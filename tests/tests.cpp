@@ -1,6 +1,31 @@
 #include <gtest/gtest.h>
-#include <classes/classes.h>
+#include <classes/notext.h>
 #include <classes/extended.h>
+#include <classes/spsc.h>
+#include <classes/mpmc.h>
+#include <classes/mirrored.h>
+#include <classes/shared.h>
+#include <classes/static.h>
+#include <classes/chunked.h>
+#include <classes/blocking.h>
+#include <classes/channel.h>
+#include <classes/window.h>
+#include <classes/simd.h>
+#include <classes/parallel.h>
+#include <classes/latency.h>
+
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <ranges>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <sys/wait.h>
 
 TEST (CircBuffer, Simple) {
     CCircularBuffer<int> a = {1, 2, 3, 4, 5};
@@ -39,6 +64,7 @@ TEST (CircBuffer, EmptyPushPop) {
 
 TEST (CircBuffer, InsertEmptyTest) {
     CCircularBuffer<int> a;
+    a.set_full_policy(CFullPolicy::Grow);
     auto it = a.begin();
     a.insert(it, 3, 4);
     ASSERT_EQ(a.size(), 3);
@@ -46,6 +72,7 @@ TEST (CircBuffer, InsertEmptyTest) {
 
 TEST (CircBuffer, InsertTestBegin) {
     CCircularBuffer<int> a = {1, 2, 3};
+    a.set_full_policy(CFullPolicy::Grow);
     auto it = a.begin();
     a.insert(it, 3, 4);
     ASSERT_EQ(a.size(), 6);
@@ -54,6 +81,7 @@ TEST (CircBuffer, InsertTestBegin) {
 
 TEST (CircBuffer, InsertTestEnd) {
     CCircularBuffer<int> a = {1, 2, 3};
+    a.set_full_policy(CFullPolicy::Grow);
     auto it = a.end();
     a.insert(it, 5, 99);
     ASSERT_EQ(a.size(), 8);
@@ -62,6 +90,7 @@ TEST (CircBuffer, InsertTestEnd) {
 
 TEST (CircBuffer, InsertTestIl) {
     CCircularBuffer<int> a = {1, 2, 3};
+    a.set_full_policy(CFullPolicy::Grow);
     std::initializer_list<int> il = {99, 98, 97};
     auto it = a.end();
     a.insert(it, il);
@@ -173,6 +202,283 @@ TEST (CircBuffer, ComplicatedTest2) {
     ASSERT_EQ(*a.begin(), 1000);
 }
 
+TEST (CircBuffer, ArraySpans) {
+    CCircularBuffer<int> a = {1, 2, 3, 4, 5};
+    ASSERT_EQ(a.array_one().size(), 5);
+    ASSERT_TRUE(a.array_two().empty());
+    a.pop_front();
+    a.pop_front();
+    a.push_back(6);
+    a.push_back(7);
+    auto one = a.array_one();
+    auto two = a.array_two();
+    ASSERT_EQ(one.size(), 3);
+    ASSERT_EQ(two.size(), 2);
+    ASSERT_EQ(one[0], 3);
+    ASSERT_EQ(one[2], 5);
+    ASSERT_EQ(two[0], 6);
+    ASSERT_EQ(two[1], 7);
+    two[1] = 70;
+    ASSERT_EQ(a.back(), 70);
+    const CCircularBuffer<int>& c = a;
+    ASSERT_EQ(c.array_one().data(), &a.front());
+    ASSERT_EQ(c.array_two().size(), 2);
+}
+
+TEST (CircBuffer, ArraySpansEmpty) {
+    CCircularBuffer<int> a;
+    ASSERT_TRUE(a.array_one().empty());
+    ASSERT_TRUE(a.array_two().empty());
+}
+
+TEST (CircBuffer, BulkPushBack) {
+    CCircularBuffer<int> a(5);
+    a.clear();
+    int in[] = {1, 2, 3, 4, 5, 6, 7};
+    a.push_back(in, in + 3);
+    ASSERT_EQ(a.size(), 3);
+    a.pop_front(2);
+    a.push_back(in + 3, in + 7);
+    // capacity is 5, so the oldest element is overwritten
+    ASSERT_EQ(a.size(), 5);
+    ASSERT_EQ(a.front(), 3);
+    ASSERT_EQ(a.back(), 7);
+    ASSERT_EQ(a.array_two().size() + a.array_one().size(), 5);
+    a.push_back(in, in + 7);
+    ASSERT_EQ(a.front(), 3);
+    ASSERT_EQ(*(a.begin() + 4), 7);
+}
+
+TEST (CircBuffer, BulkPushFront) {
+    CCircularBuffer<int> a(5);
+    a.clear();
+    int in[] = {1, 2, 3, 4};
+    a.push_back(9);
+    a.push_front(in, in + 2);
+    ASSERT_EQ(a.size(), 3);
+    ASSERT_EQ(*a.begin(), 1);
+    ASSERT_EQ(*(a.begin() + 1), 2);
+    ASSERT_EQ(*(a.begin() + 2), 9);
+    a.push_front(in + 1, in + 4);
+    // the newest elements are dropped from the back
+    ASSERT_EQ(a.size(), 5);
+    ASSERT_EQ(a.front(), 2);
+    ASSERT_EQ(*(a.begin() + 3), 1);
+    ASSERT_EQ(*(a.begin() + 4), 2);
+}
+
+TEST (CircBuffer, BulkPopCopyOut) {
+    CCircularBuffer<std::string> a = {"a", "b", "c", "d", "e"};
+    a.pop_front(2);
+    std::string more[] = {"f", "g"};
+    a.push_back(more, more + 2);
+    std::string out[5];
+    ASSERT_EQ(a.copy_out(out, 10), 5);
+    ASSERT_EQ(out[0], "c");
+    ASSERT_EQ(out[4], "g");
+    a.pop_back(3);
+    ASSERT_EQ(a.size(), 2);
+    ASSERT_EQ(a.back(), "d");
+    a.pop_front(10);
+    ASSERT_TRUE(a.empty());
+}
+
+TEST (CircBuffer, Pow2Capacity) {
+    CCircularBuffer<int> a(5, pow2Capacity);
+    ASSERT_EQ(a.capacity(), 8);
+    ASSERT_TRUE(a.empty());
+    for (int i = 0; i < 10; i++) {
+        a.push_back(i);
+    }
+    ASSERT_EQ(a.size(), 8);
+    ASSERT_EQ(a.front(), 2);
+    ASSERT_EQ(a.back(), 9);
+    ASSERT_EQ(a[5], 7);
+    a.push_front(100);
+    ASSERT_EQ(a.front(), 100);
+    ASSERT_EQ(a.back(), 8);
+    a.reserve(9);
+    ASSERT_EQ(a.capacity(), 16);
+    ASSERT_EQ(a.front(), 100);
+    ASSERT_EQ(a[7], 8);
+}
+
+struct CopyCounter {
+    static inline int copies = 0;
+    static inline int moves = 0;
+    int value;
+
+    CopyCounter(int v = 0): value(v) {}
+    CopyCounter(const CopyCounter& other): value(other.value) {
+        copies++;
+    }
+    CopyCounter(CopyCounter&& other) noexcept: value(other.value) {
+        moves++;
+    }
+    CopyCounter& operator=(const CopyCounter& other) {
+        value = other.value;
+        copies++;
+        return *this;
+    }
+    CopyCounter& operator=(CopyCounter&& other) noexcept {
+        value = other.value;
+        moves++;
+        return *this;
+    }
+};
+
+TEST (CircBuffer, RangeInsertEraseShiftShorterSide) {
+    CCircularBuffer<CopyCounter> a(10, pow2Capacity);
+    for (int i = 0; i < 10; i++) {
+        a.push_back(i);
+    }
+    CopyCounter::copies = 0;
+    CopyCounter::moves = 0;
+    a.insert(a.begin() + 2, {100, 101, 102});
+    // 3 new elements are copied, the 2-element prefix is moved, nothing is reallocated
+    ASSERT_EQ(CopyCounter::copies, 3);
+    ASSERT_EQ(CopyCounter::moves, 2);
+    ASSERT_EQ(a.capacity(), 16);
+    ASSERT_EQ(a.size(), 13);
+    ASSERT_EQ(a[1].value, 1);
+    ASSERT_EQ(a[2].value, 100);
+    ASSERT_EQ(a[5].value, 2);
+
+    CopyCounter::copies = 0;
+    CopyCounter::moves = 0;
+    a.insert(a.end() - 1, 2, CopyCounter(7));
+    ASSERT_EQ(CopyCounter::copies, 3);
+    ASSERT_EQ(CopyCounter::moves, 1);
+    ASSERT_EQ(a[13].value, 7);
+    ASSERT_EQ(a.back().value, 9);
+
+    CopyCounter::copies = 0;
+    CopyCounter::moves = 0;
+    a.erase(a.begin() + 1, a.begin() + 4);
+    ASSERT_EQ(CopyCounter::copies, 0);
+    ASSERT_EQ(CopyCounter::moves, 1);
+    ASSERT_EQ(a.front().value, 0);
+    ASSERT_EQ(a[1].value, 102);
+    ASSERT_EQ(a.size(), 12);
+
+    CopyCounter::moves = 0;
+    a.erase(a.end() - 3, a.end() - 1);
+    ASSERT_EQ(CopyCounter::moves, 1);
+    ASSERT_EQ(a.back().value, 9);
+}
+
+TEST (CircBuffer, RangeInsertGrowsOnce) {
+    CCircularBuffer<CopyCounter> a(4, pow2Capacity);
+    a.set_full_policy(CFullPolicy::Grow);
+    for (int i = 0; i < 4; i++) {
+        a.push_back(i);
+    }
+    CopyCounter values[] = {10, 11, 12, 13, 14};
+    CopyCounter::copies = 0;
+    CopyCounter::moves = 0;
+    a.insert(a.begin() + 1, std::begin(values), std::end(values));
+    // every old element is relocated once, every new one is copied once
+    ASSERT_EQ(CopyCounter::copies, 5);
+    ASSERT_EQ(CopyCounter::moves, 4);
+    ASSERT_EQ(a.capacity(), 16);
+    ASSERT_EQ(a[0].value, 0);
+    ASSERT_EQ(a[1].value, 10);
+    ASSERT_EQ(a[5].value, 14);
+    ASSERT_EQ(a[6].value, 1);
+    ASSERT_EQ(a.back().value, 3);
+}
+
+TEST (CircBuffer, MoveOnly) {
+    CCircularBuffer<std::unique_ptr<int>> a(3, pow2Capacity);
+    a.push_back(std::make_unique<int>(1));
+    a.emplace_back(new int(2));
+    a.emplace_front(new int(0));
+    a.emplace(a.begin() + 1, new int(10));
+    ASSERT_EQ(a.size(), 4);
+    ASSERT_EQ(*a[0], 0);
+    ASSERT_EQ(*a[1], 10);
+    ASSERT_EQ(*a[3], 2);
+    // full: the oldest element is overwritten
+    a.push_back(std::make_unique<int>(3));
+    ASSERT_EQ(*a.front(), 10);
+    ASSERT_EQ(*a.back(), 3);
+    a.reserve(8);
+    ASSERT_EQ(*a[2], 2);
+    a.erase(a.begin());
+    ASSERT_EQ(*a.front(), 1);
+
+    CCircularBuffer<std::unique_ptr<int>> b(std::move(a));
+    ASSERT_TRUE(a.empty());
+    ASSERT_EQ(b.size(), 3);
+    CCircularBuffer<std::unique_ptr<int>> c;
+    c = std::move(b);
+    ASSERT_EQ(*c.back(), 3);
+    ASSERT_EQ(b.capacity(), 0);
+}
+
+TEST (CircBuffer, CopyAssign) {
+    CCircularBuffer<std::string> a = {"a", "b", "c"};
+    a.push_back("d");
+    CCircularBuffer<std::string> b;
+    b = a;
+    ASSERT_TRUE(a == b);
+    b = b;
+    ASSERT_EQ(b.front(), "b");
+    a.push_back(a.front());
+    ASSERT_EQ(a.back(), "b");
+    ASSERT_EQ(a.front(), "c");
+}
+
+TEST (CircBuffer, FullPolicy) {
+    CCircularBuffer<int> a = {1, 2, 3};
+    ASSERT_EQ(a.full_policy(), CFullPolicy::Overwrite);
+    a.push_back(4);
+    a.push_front(0);
+    ASSERT_EQ(a.overwritten(), 2);
+    ASSERT_TRUE(std::ranges::equal(a, std::vector{0, 2, 3}));
+
+    a.set_full_policy(CFullPolicy::Reject);
+    ASSERT_FALSE(a.try_push_back(5));
+    ASSERT_FALSE(a.try_emplace_front(-1));
+    a.push_back(6);
+    ASSERT_EQ(a.insert(a.begin(), 7), a.end());
+    ASSERT_EQ(a.dropped(), 4);
+    a.pop_front();
+    std::vector<int> more = {8, 9, 10};
+    a.push_back(more.begin(), more.end());
+    a.pop_back(2);
+    a.push_front(more.begin(), more.end());
+    ASSERT_TRUE(std::ranges::equal(a, std::vector{9, 10, 2}));
+    ASSERT_EQ(a.dropped(), 7);
+    ASSERT_EQ(a.overwritten(), 2);
+
+    a.set_full_policy(CFullPolicy::Grow);
+    a.reset_counters();
+    ASSERT_TRUE(a.try_push_back(11));
+    a.push_front(more.begin(), more.end());
+    ASSERT_TRUE(std::ranges::equal(a, std::vector{8, 9, 10, 9, 10, 2, 11}));
+    ASSERT_EQ(a.dropped() + a.overwritten(), 0);
+    CCircularBuffer<int> b = a;
+    ASSERT_EQ(b.full_policy(), CFullPolicy::Grow);
+
+    CCircularBuffer<int> empty;
+    ASSERT_FALSE(empty.try_push_back(1));
+    ASSERT_EQ(empty.dropped(), 1);
+
+    // under Overwrite an insertion into a full buffer keeps the newest capacity() elements
+    CCircularBuffer<int> c = {1, 2, 3, 4};
+    ASSERT_EQ(*c.insert(c.begin() + 2, 9), 9);
+    ASSERT_TRUE(std::ranges::equal(c, std::vector{2, 9, 3, 4}));
+    ASSERT_EQ(c.insert(c.begin(), 7), c.end());
+    c.insert(c.end(), {5, 6});
+    ASSERT_TRUE(std::ranges::equal(c, std::vector{3, 4, 5, 6}));
+    c.insert(c.begin() + 1, 3, 0);
+    ASSERT_TRUE(std::ranges::equal(c, std::vector{0, 4, 5, 6}));
+    ASSERT_EQ(c.capacity(), 4);
+    ASSERT_EQ(c.overwritten(), 7);
+    ASSERT_EQ(c.dropped(), 0);
+}
+
 /////////////////////////////
 /// Tests for extended
 /// Differences between Extended and not-Extended buffers: push_back and push_front
@@ -216,10 +522,352 @@ TEST (CircBufferExt, ComplicatedTest1) {
     ASSERT_EQ(a.size(), 4);
 }
 
+TEST (CircBufferExt, BulkPush) {
+    CCircularBufferExt<int> a = {1, 2};
+    int in[] = {3, 4, 5, 6, 7};
+    a.push_back(in, in + 5);
+    ASSERT_EQ(a.size(), 7);
+    ASSERT_EQ(a.back(), 7);
+    a.push_front(in, in + 2);
+    ASSERT_EQ(a.size(), 9);
+    ASSERT_EQ(a.front(), 3);
+    ASSERT_EQ(*(a.begin() + 2), 1);
+}
+
+TEST (CircBufferExt, Pow2Capacity) {
+    CCircularBufferExt<int> a(3, pow2Capacity);
+    for (int i = 0; i < 5; i++) {
+        a.push_front(i);
+    }
+    ASSERT_EQ(a.capacity(), 8);
+    ASSERT_EQ(a.size(), 5);
+    ASSERT_EQ(a.front(), 4);
+    ASSERT_EQ(a.back(), 0);
+}
+
+TEST (CircBufferExt, MoveOnly) {
+    CCircularBufferExt<std::unique_ptr<std::string>> a;
+    for (int i = 0; i < 5; i++) {
+        a.emplace_back(new std::string(std::to_string(i)));
+        a.push_front(std::make_unique<std::string>("f" + std::to_string(i)));
+    }
+    ASSERT_EQ(a.size(), 10);
+    ASSERT_EQ(*a.front(), "f4");
+    ASSERT_EQ(*a.back(), "4");
+    CCircularBufferExt<std::unique_ptr<std::string>> b = std::move(a);
+    ASSERT_EQ(b.size(), 10);
+}
+
+TEST (CircBufferExt, PushOwnElement) {
+    CCircularBufferExt<std::string> a = {"first", "second"};
+    a.push_back(a.front());
+    a.push_front(a.back());
+    ASSERT_EQ(a.size(), 4);
+    ASSERT_EQ(a.back(), "first");
+    ASSERT_EQ(a.front(), "first");
+}
+
+// Rounds every allocate_at_least request up to a multiple of 6 slots.
+template<class T>
+struct RoundingAllocator : std::allocator<T> {
+    struct Result {
+        T* ptr;
+        size_t count;
+    };
+
+    RoundingAllocator() = default;
+    template<class U>
+    RoundingAllocator(const RoundingAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    Result allocate_at_least(size_t n) {
+        size_t count = (n + 5) / 6 * 6;
+        return {allocate(count), count};
+    }
+    void deallocate(T* p, size_t) {
+        ::operator delete(p);
+    }
+};
+
+TEST (CircBufferExt, AllocateAtLeast) {
+    CCircularBufferExt<int, RoundingAllocator<int>> a;
+    for (int i = 0; i < 7; i++) {
+        a.push_back(i);
+    }
+    ASSERT_EQ(a.capacity(), 12);
+    CCircularBufferExt<int, RoundingAllocator<int>> b(2, pow2Capacity);
+    for (int i = 0; i < 3; i++) {
+        b.push_back(i);
+    }
+    ASSERT_EQ(b.capacity(), 4);
+    ASSERT_EQ(b.back(), 2);
+}
+
+TEST (CircBufferExt, RelocateWrapped) {
+    CCircularBufferExt<int> a = {1, 2, 3, 4};
+    a.pop_front();
+    a.pop_front();
+    a.push_back(5);
+    a.push_back(6);
+    a.push_back(7);
+    std::vector<int> expected = {3, 4, 5, 6, 7};
+    ASSERT_TRUE(std::equal(a.begin(), a.end(), expected.begin(), expected.end()));
+
+    CCircularBufferExt<CopyCounter> b;
+    for (int i = 0; i < 9; i++) {
+        b.emplace_back(i);
+    }
+    CopyCounter::copies = 0;
+    b.push_back(CopyCounter(9));
+    ASSERT_EQ(CopyCounter::copies, 0);
+    ASSERT_EQ(b.front().value, 0);
+    ASSERT_EQ(b.back().value, 9);
+}
+
+template<class T>
+struct CountingAllocator : std::allocator<T> {
+    static inline int allocations = 0;
+
+    CountingAllocator() = default;
+    template<class U>
+    CountingAllocator(const CountingAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        allocations++;
+        return std::allocator<T>::allocate(n);
+    }
+};
+
+TEST (CircBufferExt, InlineStorage) {
+    typedef CCircularBufferExt<std::string, CountingAllocator<std::string>, 4> Small;
+    CountingAllocator<std::string>::allocations = 0;
+    Small a;
+    ASSERT_EQ(a.capacity(), 4);
+    for (int i = 0; i < 4; i++) {
+        a.push_back(std::to_string(i));
+    }
+    a.pop_front();
+    a.push_front("f");
+    Small b = std::move(a);
+    Small c = b;
+    c.swap(b);
+    ASSERT_EQ(CountingAllocator<std::string>::allocations, 0);
+    ASSERT_TRUE(a.empty());
+    ASSERT_EQ(b.front(), "f");
+
+    b.push_back("4");
+    ASSERT_EQ(CountingAllocator<std::string>::allocations, 1);
+    ASSERT_EQ(b.capacity(), 8);
+    ASSERT_EQ(b.size(), 5);
+    ASSERT_EQ(b.back(), "4");
+    b.pop_back();
+    b.reserve(0);
+    ASSERT_EQ(b.capacity(), 4);
+    ASSERT_EQ(b[3], "3");
+
+    std::vector<std::string> v {"x", "y"};
+    b.assign(v.begin(), v.end());
+    ASSERT_EQ(b.capacity(), 4);
+    ASSERT_EQ(b.back(), "y");
+    b.assign(6, "z");
+    ASSERT_EQ(b.size(), 6);
+    b.assign({"w"});
+    ASSERT_EQ(b.size(), 1);
+    ASSERT_EQ(b.front(), "w");
+    ASSERT_EQ(b.full_policy(), CFullPolicy::Grow);
+
+    // swap and move assignment carry the policies along with the elements
+    Small d;
+    d.set_incremental_growth(1);
+    d.set_shrink_policy({2, 5, 4});
+    d.push_back("d");
+    Small e;
+    e.swap(d);
+    ASSERT_EQ(e.incremental_growth(), 1);
+    ASSERT_EQ(e.shrink_policy().patience, 5);
+    ASSERT_EQ(d.incremental_growth(), 0);
+    ASSERT_EQ(d.shrink_policy().patience, 0);
+    b = std::move(e);
+    ASSERT_EQ(b.front(), "d");
+    ASSERT_EQ(b.incremental_growth(), 1);
+    ASSERT_EQ(b.shrink_policy().minCapacity, 4);
+}
+
+TEST (CircBufferExt, ShrinkToFit) {
+    CCircularBufferExt<std::string> a;
+    for (int i = 0; i < 100; i++) {
+        a.push_back(std::to_string(i));
+    }
+    a.pop_front(97);
+    a.push_back("100");
+    a.shrink_to_fit();
+    ASSERT_EQ(a.capacity(), 4);
+    ASSERT_EQ(a.front(), "97");
+    ASSERT_EQ(a.back(), "100");
+    a.pop_front(4);
+    a.shrink_to_fit();
+    ASSERT_EQ(a.capacity(), 0);
+
+    CCircularBufferExt<int, std::allocator<int>, 8> b(20, 1);
+    b.pop_back(15);
+    b.shrink_to_fit();
+    ASSERT_EQ(b.capacity(), 8);
+    ASSERT_EQ(b.size(), 5);
+}
+
+TEST (CircBufferExt, ShrinkPolicy) {
+    CCircularBufferExt<int> a;
+    a.set_shrink_policy({4, 3, 8});
+    for (int i = 0; i < 64; i++) {
+        a.push_back(i);
+    }
+    a.pop_front(50);
+    a.pop_front();
+    ASSERT_EQ(a.capacity(), 64);
+    a.pop_front();
+    ASSERT_EQ(a.capacity(), 32);
+    a.pop_front(4);
+    // an operation above capacity() / 4 restarts the count
+    a.push_back(100);
+    a.pop_front();
+    a.pop_front();
+    ASSERT_EQ(a.capacity(), 32);
+    a.pop_front();
+    ASSERT_EQ(a.capacity(), 16);
+    ASSERT_EQ(a.size(), 6);
+    ASSERT_EQ(a.front(), 59);
+    ASSERT_EQ(a.back(), 100);
+    a.pop_front(3);
+    a.pop_front();
+    a.pop_front();
+    ASSERT_EQ(a.capacity(), 8);
+    a.pop_front();
+    ASSERT_EQ(a.capacity(), 8);
+
+    // a buffer moved in keeps shrinking
+    CCircularBufferExt<int> b;
+    b.reserve(64);
+    b.push_back(1);
+    b.set_shrink_policy({4, 1, 8});
+    a = std::move(b);
+    ASSERT_EQ(a.capacity(), 64);
+    a.pop_front();
+    ASSERT_EQ(a.capacity(), 32);
+}
+
+TEST (CircBufferExt, IncrementalGrowth) {
+    CCircularBufferExt<CopyCounter> a;
+    a.set_incremental_growth(2);
+    a.reserve(64);
+    for (int i = 0; i < 64; i++) {
+        a.emplace_back(i);
+    }
+    CopyCounter::moves = 0;
+    CopyCounter::copies = 0;
+    a.emplace_back(64);
+    ASSERT_EQ(a.capacity(), 128);
+    // the new element plus two migrated ones
+    ASSERT_LE(CopyCounter::moves, 3);
+    ASSERT_EQ(CopyCounter::copies, 0);
+
+    std::deque<int> expected;
+    for (int i = 0; i <= 64; i++) {
+        expected.push_back(i);
+    }
+    auto check = [&] {
+        ASSERT_EQ(a.size(), expected.size());
+        ASSERT_EQ(a.front().value, expected.front());
+        ASSERT_EQ(a.back().value, expected.back());
+        size_t i = 0;
+        for (const CopyCounter& x : a) {
+            ASSERT_EQ(x.value, expected[i]);
+            ASSERT_EQ(a[i].value, expected[i]);
+            i++;
+        }
+    };
+    for (int i = 0; i < 20; i++) {
+        a.emplace_front(-i);
+        expected.push_front(-i);
+        a.pop_back();
+        expected.pop_back();
+        if (i % 3 == 0) {
+            a.pop_front();
+            expected.pop_front();
+        }
+        check();
+    }
+    a.insert(a.begin() + 1, CopyCounter(1000));
+    expected.insert(expected.begin() + 1, 1000);
+    check();
+
+    // reads through copy_out and the destructor with a migration still pending
+    CCircularBufferExt<std::string> b;
+    b.set_incremental_growth(1);
+    for (int i = 0; i < 9; i++) {
+        b.push_back(std::to_string(i));
+    }
+    std::vector<std::string> out(9);
+    ASSERT_EQ(b.copy_out(out.begin(), 9), 9);
+    ASSERT_EQ(out[0], "0");
+    ASSERT_EQ(out[8], "8");
+    CCircularBufferExt<std::string> c = b;
+    ASSERT_TRUE(c == b);
+    c.erase(c.begin());
+    ASSERT_EQ(c.front(), "1");
+    ASSERT_EQ(c.size(), 8);
+
+    // pops through a base reference taken while a migration is pending
+    CCircularBufferExt<std::string> d;
+    d.set_incremental_growth(1);
+    for (int i = 0; i < 9; i++) {
+        d.push_back(std::to_string(i));
+    }
+    CCircularBuffer<std::string>& base = d.as_base();
+    base.pop_front();
+    base.pop_back();
+    ASSERT_EQ(base.front(), "1");
+    ASSERT_EQ(base.back(), "7");
+    ASSERT_EQ(base[3], "4");
+    ASSERT_TRUE(std::ranges::equal(d, std::vector<std::string>{"1", "2", "3", "4", "5", "6", "7"}));
+}
+
+TEST (CircBufferExt, FullPolicy) {
+    CCircularBufferExt<int, std::allocator<int>, 2> a;
+    ASSERT_EQ(a.full_policy(), CFullPolicy::Grow);
+    a.set_full_policy(CFullPolicy::Reject);
+    ASSERT_TRUE(a.try_push_back(1));
+    ASSERT_TRUE(a.try_push_front(0));
+    ASSERT_FALSE(a.try_push_back(2));
+    ASSERT_EQ(a.capacity(), 2);
+    CCircularBufferExt<int, std::allocator<int>, 2> b = std::move(a);
+    b.set_full_policy(CFullPolicy::Overwrite);
+    b.push_back(2);
+    ASSERT_TRUE(std::ranges::equal(b, std::vector{1, 2}));
+    ASSERT_EQ(b.overwritten(), 1);
+    b.set_full_policy(CFullPolicy::Grow);
+    b.push_front(0);
+    ASSERT_TRUE(std::ranges::equal(b, std::vector{0, 1, 2}));
+    ASSERT_EQ(a.full_policy(), CFullPolicy::Reject);
+    ASSERT_EQ(a.dropped(), 1);
+}
+
+TEST (CircBufferExt, AsBase) {
+    static_assert(!std::is_convertible_v<CCircularBufferExt<int>&, CCircularBuffer<int>&>);
+    CCircularBufferExt<int> a = {1, 2};
+    CCircularBuffer<int>& b = a.as_base();
+    ASSERT_EQ(b.size(), b.capacity());
+    b.push_back(3);
+    b.push_front(0);
+    ASSERT_TRUE(std::ranges::equal(a, std::vector{0, 1, 2, 3}));
+    ASSERT_EQ(CCircularBufferSimd::sum(a.as_base()), 6);
+}
+
 TEST (Algo, AlgoTest1) {
     CCircularBuffer<int> a = {414414, 2112, 1, 222, 412};
     ASSERT_FALSE(std::is_sorted(a.cbegin(), a.cend()));
-    sort(a.begin(), a.end());
+    std::sort(a.begin(), a.end());
     ASSERT_TRUE(std::is_sorted(a.cbegin(), a.cend()));
     ASSERT_EQ(*a.begin(), 1);
     ASSERT_EQ(*(a.begin() + 1), 222);
@@ -230,8 +878,1086 @@ TEST (Algo, AlgoTest1) {
 
 TEST (Algo, AlgoTest2) {
     CCircularBuffer<int> a = {414414, 2112, 1, 222, 412};
-    sort(a.begin(), a.end());
+    std::sort(a.begin(), a.end());
     ASSERT_EQ(*std::lower_bound(a.begin(), a.end(), 1000), 2112);
     ASSERT_EQ(*std::upper_bound(a.begin(), a.end(), 1), 222);
 }
 
+TEST (Algo, IteratorConcepts) {
+    typedef CCircularBuffer<int>::iterator iterator;
+    typedef CCircularBuffer<int>::const_iterator const_iterator;
+    static_assert(std::random_access_iterator<iterator>);
+    static_assert(std::random_access_iterator<const_iterator>);
+    static_assert(std::sized_sentinel_for<iterator, iterator>);
+    static_assert(std::ranges::random_access_range<CCircularBuffer<int>>);
+    static_assert(std::ranges::sized_range<const CCircularBuffer<int>>);
+    CCircularBuffer<int> a = {1, 2, 3};
+    const_iterator it = a.begin();
+    ASSERT_TRUE(it == a.begin());
+    ASSERT_TRUE(a.begin() < a.end());
+    ASSERT_EQ(a.end() - it, 3);
+    ASSERT_EQ(it[2], 3);
+    ASSERT_EQ(*(2 + it), 3);
+}
+
+TEST (Algo, WrappedSortAndReverse) {
+    CCircularBuffer<int> a = {5, 4, 3, 2, 1};
+    a.push_back(9);
+    a.push_back(0);
+    // storage is now wrapped: 3 2 1 | 9 0
+    std::ranges::sort(a);
+    int expected[] = {0, 1, 2, 3, 9};
+    ASSERT_TRUE(std::equal(a.begin(), a.end(), expected));
+    ASSERT_EQ(*std::ranges::lower_bound(a, 3), 3);
+    int i = 4;
+    for (auto it = a.rbegin(); it != a.rend(); ++it, --i) {
+        ASSERT_EQ(*it, expected[i]);
+    }
+    int sum = 0;
+    for (int x : a | std::views::reverse) {
+        sum += x;
+    }
+    ASSERT_EQ(sum, 15);
+    CCircularBuffer<int> empty;
+    ASSERT_TRUE(empty.begin() == empty.end());
+}
+
+TEST (SPSC, PushPop) {
+    CCircularBufferSPSC<int> a(3);
+    ASSERT_TRUE(a.empty());
+    ASSERT_TRUE(a.try_push(1));
+    ASSERT_TRUE(a.try_push(2));
+    ASSERT_TRUE(a.try_push(3));
+    ASSERT_FALSE(a.try_push(4));
+    ASSERT_EQ(a.size(), 3);
+    int value;
+    ASSERT_TRUE(a.try_pop(value));
+    ASSERT_EQ(value, 1);
+    ASSERT_TRUE(a.try_push(4));
+    ASSERT_EQ(*a.front(), 2);
+    a.pop();
+    ASSERT_TRUE(a.try_pop(value));
+    ASSERT_EQ(value, 3);
+    ASSERT_TRUE(a.try_pop(value));
+    ASSERT_EQ(value, 4);
+    ASSERT_FALSE(a.try_pop(value));
+    ASSERT_EQ(a.front(), nullptr);
+}
+
+TEST (SPSC, TwoThreads) {
+    CCircularBufferSPSC<int> a(16);
+    const int n = 100000;
+    std::thread producer([&a] {
+        for (int i = 0; i < n; i++) {
+            while (!a.try_push(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    long long sum = 0;
+    int expected = 0;
+    bool ordered = true;
+    for (int i = 0; i < n; i++) {
+        int value;
+        while (!a.try_pop(value)) {
+            std::this_thread::yield();
+        }
+        ordered = ordered && value == expected++;
+        sum += value;
+    }
+    producer.join();
+    ASSERT_TRUE(ordered);
+    ASSERT_EQ(sum, (long long) n * (n - 1) / 2);
+    ASSERT_TRUE(a.empty());
+}
+
+TEST (MPMC, PushPop) {
+    CCircularBufferMPMC<int> a(3);
+    ASSERT_EQ(a.capacity(), 4);
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(a.try_push(i));
+    }
+    ASSERT_FALSE(a.try_push(4));
+    int value;
+    ASSERT_TRUE(a.try_pop(value));
+    ASSERT_EQ(value, 0);
+    ASSERT_TRUE(a.try_push(4));
+    for (int i = 1; i < 5; i++) {
+        ASSERT_TRUE(a.try_pop(value));
+        ASSERT_EQ(value, i);
+    }
+    ASSERT_FALSE(a.try_pop(value));
+    ASSERT_TRUE(a.empty());
+}
+
+TEST (MPMC, Batch) {
+    CCircularBufferMPMC<int> a(8);
+    int in[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    ASSERT_EQ(a.try_push(in, in + 10), 8);
+    ASSERT_EQ(a.size(), 8);
+    int out[10] = {};
+    ASSERT_EQ(a.try_pop(out, 5), 5);
+    ASSERT_EQ(out[0], 1);
+    ASSERT_EQ(out[4], 5);
+    ASSERT_EQ(a.try_push(in + 8, in + 10), 2);
+    ASSERT_EQ(a.try_pop(out, 10), 5);
+    ASSERT_EQ(out[2], 8);
+    ASSERT_EQ(out[4], 10);
+    ASSERT_TRUE(a.empty());
+}
+
+TEST (MPMC, EmptyBatch) {
+    CCircularBufferMPMC<int> a(4);
+    int in[] = {1, 2};
+    int out[2] = {};
+    ASSERT_EQ(a.try_push(in, in), 0);
+    ASSERT_EQ(a.try_pop(out, 0), 0);
+    ASSERT_EQ(a.try_push(in, in + 2), 2);
+    ASSERT_EQ(a.try_push(in, in), 0);
+    ASSERT_EQ(a.try_pop(out, 0), 0);
+    ASSERT_EQ(a.size(), 2);
+    ASSERT_EQ(a.try_pop(out, 2), 2);
+    ASSERT_EQ(out[1], 2);
+}
+
+TEST (MPMC, TinyCapacity) {
+    for (size_t capacity : {0, 1}) {
+        CCircularBufferMPMC<int> a(capacity);
+        ASSERT_EQ(a.capacity(), 2);
+        ASSERT_TRUE(a.try_push(1));
+        ASSERT_TRUE(a.try_push(2));
+        ASSERT_FALSE(a.try_push(3));
+        ASSERT_EQ(a.size(), 2);
+        int value = 0;
+        ASSERT_TRUE(a.try_pop(value));
+        ASSERT_EQ(value, 1);
+        ASSERT_TRUE(a.try_pop(value));
+        ASSERT_EQ(value, 2);
+        ASSERT_FALSE(a.try_pop(value));
+    }
+}
+
+TEST (MPMC, ManyThreads) {
+    CCircularBufferMPMC<int> a(64);
+    const int producers = 3;
+    const int consumers = 3;
+    const int n = 20000;
+    std::atomic<long long> sum = 0;
+    std::atomic<int> popped = 0;
+    std::thread threads[producers + consumers];
+    for (int p = 0; p < producers; p++) {
+        threads[p] = std::thread([&a] {
+            for (int i = 1; i <= n; i++) {
+                while (!a.try_push(i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (int c = 0; c < consumers; c++) {
+        threads[producers + c] = std::thread([&] {
+            int value;
+            while (popped.load() < producers * n) {
+                if (a.try_pop(value)) {
+                    sum += value;
+                    popped++;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    ASSERT_EQ(sum.load(), (long long) producers * n * (n + 1) / 2);
+    ASSERT_TRUE(a.empty());
+}
+
+TEST (Mirrored, ContiguousAcrossWrap) {
+    CCircularBufferMirrored<int> a(100);
+    size_t capacity = a.capacity();
+    ASSERT_GE(capacity, 100);
+    for (size_t i = 0; i < capacity - 2; i++) {
+        a.push_back(-1);
+    }
+    a.pop_front(capacity - 2);
+    for (int i = 0; i < 5; i++) {
+        a.push_back(i);
+    }
+    std::span<int> s = a.span();
+    ASSERT_EQ(s.size(), 5);
+    for (int i = 0; i < 5; i++) {
+        ASSERT_EQ(s[i], i);
+    }
+    ASSERT_EQ(a.end() - a.begin(), 5);
+    ASSERT_EQ(a[4], 4);
+}
+
+TEST (Mirrored, BulkAndOverwrite) {
+    CCircularBufferMirrored<char> a(1);
+    size_t capacity = a.capacity();
+    std::string text(capacity + 3, 'x');
+    text.back() = 'y';
+    a.push_back(text.data(), text.size());
+    ASSERT_EQ(a.size(), capacity);
+    ASSERT_EQ(a.back(), 'y');
+    a.pop_front(capacity - 2);
+    std::span<char> free = a.write_span();
+    ASSERT_EQ(free.size(), capacity - 2);
+    std::memcpy(free.data(), "abc", 3);
+    a.commit(3);
+    ASSERT_EQ(std::string(a.begin(), a.end()), "xyabc");
+    a.push_front('z');
+    ASSERT_EQ(a.front(), 'z');
+
+    CCircularBufferMirrored<char> b(1);
+    b.pop_front();
+    b.pop_back();
+    ASSERT_EQ(b.size(), 0);
+    ASSERT_EQ(b.write_span().size(), b.capacity());
+    b.push_back('a');
+    ASSERT_EQ(std::string(b.begin(), b.end()), "a");
+}
+
+struct SharedRecord {
+    int64_t id;
+    double value;
+};
+
+struct SharedPair {
+    double first;
+    int64_t second;
+};
+
+TEST (Shared, AttachByName) {
+    std::string name = "/circbuf-test-" + std::to_string(getpid());
+    CCircularBufferShared<SharedRecord> producer = CCircularBufferShared<SharedRecord>::create(name.c_str(), 5);
+    CCircularBufferShared<SharedRecord> consumer = CCircularBufferShared<SharedRecord>::attach(name.c_str());
+    ASSERT_THROW(CCircularBufferShared<int>::attach(name.c_str()), std::runtime_error);
+    // same size and alignment, different type
+    ASSERT_THROW(CCircularBufferShared<SharedPair>::attach(name.c_str()), std::runtime_error);
+    ASSERT_THROW(CCircularBufferShared<SharedRecord>::attach(name.c_str(), 7), std::runtime_error);
+    CCircularBufferShared<SharedRecord>::remove(name.c_str());
+    CCircularBufferShared<SharedRecord> tagged = CCircularBufferShared<SharedRecord>::create(name.c_str(), 2, 7);
+    ASSERT_NO_THROW(CCircularBufferShared<SharedPair>::attach(name.c_str(), 7));
+    CCircularBufferShared<SharedRecord>::remove(name.c_str());
+    ASSERT_EQ(consumer.capacity(), 8);
+    for (int64_t i = 0; i < 8; i++) {
+        ASSERT_TRUE(producer.try_push({i, i * 0.5}));
+    }
+    ASSERT_FALSE(producer.try_push({8, 4.0}));
+    SharedRecord records[5];
+    ASSERT_EQ(consumer.try_pop(records, 5), 5);
+    ASSERT_EQ(records[4].id, 4);
+    SharedRecord more[6] = {{8, 0}, {9, 0}, {10, 0}, {11, 0}, {12, 0}, {13, 0}};
+    ASSERT_EQ(producer.try_push(more, 6), 5);
+    ASSERT_EQ(consumer.size(), 8);
+    SharedRecord record;
+    for (int64_t i = 5; i < 13; i++) {
+        ASSERT_TRUE(consumer.try_pop(record));
+        ASSERT_EQ(record.id, i);
+    }
+    ASSERT_FALSE(consumer.try_pop(record));
+}
+
+TEST (Shared, TwoProcesses) {
+    std::string name = "/circbuf-fork-" + std::to_string(getpid());
+    CCircularBufferShared<int64_t> consumer = CCircularBufferShared<int64_t>::create(name.c_str(), 16);
+    const int64_t count = 10000;
+    pid_t child = fork();
+    ASSERT_NE(child, -1);
+    if (child == 0) {
+        CCircularBufferShared<int64_t> producer = CCircularBufferShared<int64_t>::attach(name.c_str());
+        for (int64_t i = 0; i < count;) {
+            if (producer.try_push(i)) {
+                i++;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        _exit(0);
+    }
+    int64_t expected = 0;
+    while (expected < count) {
+        int64_t value;
+        if (consumer.try_pop(value)) {
+            ASSERT_EQ(value, expected);
+            expected++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    int status;
+    waitpid(child, &status, 0);
+    CCircularBufferShared<int64_t>::remove(name.c_str());
+    ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+constexpr int StaticSum() {
+    CCircularBufferStatic<int, 4> a = {1, 2, 3};
+    for (int i = 4; i < 8; i++) {
+        a.push_back(i);
+    }
+    a.push_front(0);
+    int sum = 0;
+    for (int value : a) {
+        sum += value;
+    }
+    return sum;
+}
+
+TEST (Static, Constexpr) {
+    static_assert(StaticSum() == 0 + 4 + 5 + 6);
+    static_assert(sizeof(CCircularBufferStatic<int, 64>) <= 64 * sizeof(int) + 2 * sizeof(int));
+    static_assert(std::random_access_iterator<CCircularBufferStatic<int, 3>::iterator>);
+}
+
+TEST (Static, NonPow2Wrap) {
+    CCircularBufferStatic<std::string, 3> a;
+    for (int i = 0; i < 5; i++) {
+        a.push_back(std::to_string(i));
+    }
+    ASSERT_TRUE(a.full());
+    ASSERT_EQ(a.front(), "2");
+    ASSERT_EQ(a.back(), "4");
+    ASSERT_EQ(a.array_one().size() + a.array_two().size(), 3);
+    a.pop_front();
+    a.emplace_front(3, 'x');
+    ASSERT_EQ(a[0], "xxx");
+    CCircularBufferStatic<std::string, 3> b = a;
+    std::sort(b.begin(), b.end());
+    ASSERT_EQ(b[0], "3");
+    ASSERT_EQ(*b.rbegin(), "xxx");
+    CCircularBufferStatic<std::string, 3> c = std::move(b);
+    ASSERT_TRUE(b.empty());
+    ASSERT_EQ(c.size(), 3);
+    c.swap(a);
+    ASSERT_EQ(a[1], "4");
+}
+
+TEST (Static, EmptyPop) {
+    CCircularBufferStatic<std::string, 3> a;
+    a.pop_front();
+    a.pop_back();
+    ASSERT_TRUE(a.empty());
+    a.push_back("0");
+    a.pop_back();
+    a.pop_back();
+    a.pop_front();
+    ASSERT_TRUE(a.empty());
+    a.push_back("1");
+    ASSERT_EQ(a.size(), 1);
+    ASSERT_EQ(a.front(), "1");
+}
+
+TEST (Chunked, GrowAndDrain) {
+    CountingAllocator<int>::allocations = 0;
+    CCircularBufferChunked<int, CountingAllocator<int>, 4> a;
+    std::deque<int> expected;
+    for (int i = 0; i < 10; i++) {
+        a.push_back(i);
+        a.push_front(-i);
+        expected.push_back(i);
+        expected.push_front(-i);
+    }
+    ASSERT_EQ(a.size(), 20);
+    ASSERT_EQ(a.chunk_count(), 6);
+    ASSERT_TRUE(std::ranges::equal(a, expected));
+    ASSERT_TRUE(std::ranges::equal(a | std::views::reverse, expected | std::views::reverse));
+    for (size_t i = 0; i < expected.size(); i++) {
+        ASSERT_EQ(a[i], expected[i]);
+    }
+    size_t total = 0;
+    a.for_each_chunk([&](std::span<int> span) {
+        ASSERT_LE(span.size(), 4);
+        total += span.size();
+    });
+    ASSERT_EQ(total, 20);
+
+    // draining hands chunks back to the allocator beyond the pooled one
+    while (a.size() > 2) {
+        a.pop_front();
+        a.pop_back();
+        expected.pop_front();
+        expected.pop_back();
+    }
+    ASSERT_LE(a.chunk_count(), 2);
+    ASSERT_EQ(a.pool_size(), 1);
+    ASSERT_TRUE(std::ranges::equal(a, expected));
+    int allocations = CountingAllocator<int>::allocations;
+    for (int i = 0; i < 4; i++) {
+        a.push_back(i);
+    }
+    ASSERT_EQ(CountingAllocator<int>::allocations, allocations);
+    a.clear();
+    a.shrink_to_fit();
+    ASSERT_EQ(a.chunk_count(), 0);
+    ASSERT_EQ(a.pool_size(), 0);
+}
+
+TEST (Chunked, StableAddresses) {
+    CCircularBufferChunked<std::string, std::allocator<std::string>, 8> a = {"a", "b"};
+    const std::string* first = &a.front();
+    for (int i = 0; i < 100; i++) {
+        a.emplace_back(3, 'x');
+    }
+    ASSERT_EQ(&a.front(), first);
+    CCircularBufferChunked<std::string, std::allocator<std::string>, 8> b = a;
+    CCircularBufferChunked<std::string, std::allocator<std::string>, 8> c = std::move(a);
+    ASSERT_TRUE(a.empty());
+    ASSERT_EQ(&c.front(), first);
+    ASSERT_TRUE(std::ranges::equal(b, c));
+    a = b;
+    ASSERT_EQ(a.size(), 102);
+    ASSERT_EQ(a[101], "xxx");
+}
+
+struct ThrowOnNegative {
+    int value;
+
+    ThrowOnNegative(int v): value(v) {
+        if (v < 0) {
+            throw std::runtime_error("negative");
+        }
+    }
+};
+
+TEST (Chunked, ThrowingConstructor) {
+    CCircularBufferChunked<ThrowOnNegative, std::allocator<ThrowOnNegative>, 2> a;
+    ASSERT_THROW(a.emplace_back(-1), std::runtime_error);
+    ASSERT_THROW(a.emplace_front(-1), std::runtime_error);
+    ASSERT_TRUE(a.empty());
+    ASSERT_EQ(a.chunk_count(), 0);
+    a.emplace_back(1);
+    a.emplace_back(2);
+    a.emplace_front(0);
+    a.pop_front();
+    // both edge chunks are full, so each push needs a new chunk
+    ASSERT_THROW(a.emplace_back(-1), std::runtime_error);
+    ASSERT_THROW(a.emplace_front(-1), std::runtime_error);
+    ASSERT_EQ(a.size(), 2);
+    ASSERT_EQ(a.chunk_count(), 1);
+    ASSERT_EQ(a.front().value, 1);
+    ASSERT_EQ(a.back().value, 2);
+    a.emplace_back(3);
+    a.emplace_front(0);
+    ASSERT_EQ(a.size(), 4);
+    for (int i = 0; i < 4; i++) {
+        ASSERT_EQ(a[i].value, i);
+    }
+    a.pop_back();
+    a.pop_front();
+    ASSERT_EQ(a.back().value, 2);
+}
+
+TEST (Blocking, Timeouts) {
+    CCircularBufferBlocking<std::string> a(2);
+    std::string value;
+    ASSERT_FALSE(a.pop_for(value, std::chrono::milliseconds(5)));
+    a.push("a");
+    std::string b = "b";
+    ASSERT_TRUE(a.try_push(std::move(b)));
+    std::string c = "c";
+    ASSERT_FALSE(a.push_for(std::move(c), std::chrono::milliseconds(5)));
+    ASSERT_EQ(c, "c");
+    ASSERT_EQ(a.size(), 2);
+    a.pop(value);
+    ASSERT_EQ(value, "a");
+    ASSERT_TRUE(a.push_for(std::move(c), std::chrono::milliseconds(5)));
+    ASSERT_TRUE(a.pop_for(value, std::chrono::milliseconds(5)));
+    ASSERT_EQ(value, "b");
+    ASSERT_TRUE(a.try_pop(value));
+    ASSERT_EQ(value, "c");
+    ASSERT_TRUE(a.empty());
+}
+
+TEST (Blocking, ManyThreads) {
+    const int producers = 3;
+    const int perProducer = 20000;
+    CCircularBufferBlocking<int> a(8);
+    std::atomic<long long> sum = 0;
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&a, p] {
+            for (int i = 1; i <= perProducer; i++) {
+                a.push(p * perProducer + i);
+            }
+        });
+    }
+    for (int c = 0; c < 2; c++) {
+        threads.emplace_back([&a, &sum] {
+            int value;
+            while (true) {
+                a.pop(value);
+                if (value == 0) {
+                    break;
+                }
+                sum += value;
+            }
+        });
+    }
+    for (int p = 0; p < producers; p++) {
+        threads[p].join();
+    }
+    a.push(0);
+    a.push(0);
+    for (size_t t = producers; t < threads.size(); t++) {
+        threads[t].join();
+    }
+    long long n = (long long) producers * perProducer;
+    ASSERT_EQ(sum, n * (n + 1) / 2);
+    ASSERT_TRUE(a.empty());
+}
+
+// Lazily started coroutine and a run queue that resumes spawned coroutines in order;
+// after their first resume the channels' own run queue resumes them.
+struct ChannelTask {
+    struct promise_type {
+        ChannelTask get_return_object() {
+            return {std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+        std::suspend_always final_suspend() noexcept {
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() {
+            std::terminate();
+        }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+struct ChannelExecutor {
+    std::deque<std::coroutine_handle<>> ready;
+    std::vector<std::coroutine_handle<>> owned;
+
+    void spawn(ChannelTask task) {
+        ready.push_back(task.handle);
+        owned.push_back(task.handle);
+    }
+
+    void run() {
+        while (!ready.empty()) {
+            std::coroutine_handle<> handle = ready.front();
+            ready.pop_front();
+            handle.resume();
+        }
+    }
+
+    bool all_done() const {
+        return std::ranges::all_of(owned, [](std::coroutine_handle<> handle) { return handle.done(); });
+    }
+
+    ~ChannelExecutor() {
+        for (std::coroutine_handle<> handle : owned) {
+            handle.destroy();
+        }
+    }
+};
+
+ChannelTask ChannelProducer(CCircularBufferChannel<std::string>& channel, int id, int n, int& running) {
+    for (int i = 0; i < n; i++) {
+        bool delivered = co_await channel.push(std::to_string(id * 1000 + i));
+        EXPECT_TRUE(delivered);
+    }
+    if (--running == 0) {
+        channel.close();
+    }
+}
+
+ChannelTask ChannelConsumer(CCircularBufferChannel<std::string>& channel, std::vector<int>& received) {
+    while (std::optional<std::string> value = co_await channel.pop()) {
+        received.push_back(std::stoi(*value));
+    }
+}
+
+TEST (Channel, ProducersAndConsumers) {
+    CCircularBufferChannel<std::string> channel(2);
+    ChannelExecutor executor;
+    std::vector<int> first;
+    std::vector<int> second;
+    int running = 3;
+    executor.spawn(ChannelConsumer(channel, first));
+    executor.spawn(ChannelConsumer(channel, second));
+    for (int id = 1; id <= 3; id++) {
+        executor.spawn(ChannelProducer(channel, id, 50, running));
+    }
+    executor.run();
+    ASSERT_TRUE(executor.all_done());
+    ASSERT_EQ(first.size() + second.size(), 150);
+    std::vector<int> all = first;
+    all.insert(all.end(), second.begin(), second.end());
+    std::ranges::sort(all);
+    for (int id = 1; id <= 3; id++) {
+        for (int i = 0; i < 50; i++) {
+            ASSERT_EQ(all[(id - 1) * 50 + i], id * 1000 + i);
+        }
+    }
+    // each consumer sees the values of one producer in order
+    for (const std::vector<int>& received : {first, second}) {
+        std::vector<int> last(4, -1);
+        for (int value : received) {
+            ASSERT_GT(value % 1000, last[value / 1000]);
+            last[value / 1000] = value % 1000;
+        }
+    }
+}
+
+TEST (Channel, ZeroCapacityAndClose) {
+    CCircularBufferChannel<int> channel(0);
+    ASSERT_FALSE(channel.try_push(1));
+    ChannelExecutor executor;
+    executor.spawn([](CCircularBufferChannel<int>& channel) -> ChannelTask {
+        for (int i = 0; i < 3; i++) {
+            co_await channel.push(i);
+        }
+        bool delivered = co_await channel.push(3);
+        EXPECT_FALSE(delivered);
+    }(channel));
+    executor.run();
+    ASSERT_EQ(channel.try_pop(), 0);
+    ASSERT_EQ(channel.try_pop(), 1);
+    ASSERT_EQ(channel.try_pop(), 2);
+    ASSERT_FALSE(executor.all_done());
+    channel.close();
+    ASSERT_TRUE(executor.all_done());
+    ASSERT_FALSE(channel.try_pop().has_value());
+    ASSERT_FALSE(channel.try_push(4));
+}
+
+ChannelTask ChannelRelay(CCircularBufferChannel<int>& in, CCircularBufferChannel<int>& out, int& depth, int& maxDepth) {
+    std::optional<int> value = co_await in.pop();
+    maxDepth = std::max(maxDepth, ++depth);
+    co_await out.push(*value + 1);
+    depth--;
+}
+
+TEST (Channel, WakeupChainDoesNotNest) {
+    const int n = 1000;
+    std::deque<CCircularBufferChannel<int>> channels;
+    for (int i = 0; i <= n; i++) {
+        channels.emplace_back(0);
+    }
+    ChannelExecutor executor;
+    int depth = 0;
+    int maxDepth = 0;
+    for (int i = n - 1; i >= 0; i--) {
+        executor.spawn(ChannelRelay(channels[i], channels[i + 1], depth, maxDepth));
+    }
+    executor.spawn([](CCircularBufferChannel<int>& last, int expected) -> ChannelTask {
+        std::optional<int> value = co_await last.pop();
+        EXPECT_EQ(value, expected);
+    }(channels[n], n));
+    executor.run();
+    ASSERT_TRUE(channels[0].try_push(0));
+    ASSERT_TRUE(executor.all_done());
+    ASSERT_EQ(maxDepth, 1);
+}
+
+TEST (Channel, DestroyWhileSuspended) {
+    CCircularBufferChannel<std::string> channel(1);
+    std::vector<int> received;
+    ChannelTask consumer = ChannelConsumer(channel, received);
+    consumer.handle.resume();
+    consumer.handle.destroy();
+    ASSERT_TRUE(channel.try_push("1"));
+    ASSERT_EQ(channel.size(), 1);
+
+    int running = 2;
+    ChannelTask producer = ChannelProducer(channel, 0, 1, running);
+    producer.handle.resume();
+    ASSERT_FALSE(producer.handle.done());
+    producer.handle.destroy();
+    ASSERT_EQ(channel.try_pop(), "1");
+    ASSERT_FALSE(channel.try_pop().has_value());
+}
+
+TEST (Window, MatchesFullScan) {
+    CCircularBufferWindow<double> a(7);
+    std::deque<double> expected;
+    unsigned seed = 12345;
+    for (int i = 0; i < 1000; i++) {
+        seed = seed * 1103515245 + 12345;
+        double value = 1e6 + (seed >> 16) % 1000 / 8.0;
+        a.push_back(value);
+        expected.push_back(value);
+        if (expected.size() > 7) {
+            expected.pop_front();
+        }
+        double sum = 0;
+        for (double x : expected) {
+            sum += x;
+        }
+        double mean = sum / expected.size();
+        double m2 = 0;
+        for (double x : expected) {
+            m2 += (x - mean) * (x - mean);
+        }
+        ASSERT_EQ(a.size(), expected.size());
+        ASSERT_EQ(a.min(), std::ranges::min(expected));
+        ASSERT_EQ(a.max(), std::ranges::max(expected));
+        ASSERT_NEAR(a.sum(), sum, 1e-6);
+        ASSERT_NEAR(a.mean(), mean, 1e-9);
+        ASSERT_NEAR(a.variance(), m2 / expected.size(), 1e-6);
+    }
+    ASSERT_TRUE(std::ranges::equal(a.samples(), expected));
+}
+
+TEST (Window, IntegersAndClear) {
+    CCircularBufferWindow<int> a(3);
+    for (int value : {5, 1, 4, 4, 9, 2}) {
+        a.push_back(value);
+    }
+    ASSERT_TRUE(a.full());
+    ASSERT_EQ(a.min(), 2);
+    ASSERT_EQ(a.max(), 9);
+    ASSERT_EQ(a.sum(), 15);
+    ASSERT_EQ(a.mean(), 5);
+    ASSERT_NEAR(a.sample_variance(), 13, 1e-12);
+    a.clear();
+    ASSERT_TRUE(a.empty());
+    a.push_back(-3);
+    ASSERT_EQ(a.min(), -3);
+    ASSERT_EQ(a.max(), -3);
+    ASSERT_EQ(a.variance(), 0);
+}
+
+template<class T>
+void CheckSimd(const CCircularBuffer<T>& a, const CCircularBuffer<T>& b) {
+    std::vector<T> values(a.begin(), a.end());
+    std::vector<T> others(b.begin(), b.end());
+    ASSERT_FALSE(a.array_two().empty());
+    ASSERT_EQ(CCircularBufferSimd::find(a, T(7)) - a.begin(), std::ranges::find(values, T(7)) - values.begin());
+    ASSERT_EQ(CCircularBufferSimd::find(a, T(-1)), a.end());
+    ASSERT_EQ(CCircularBufferSimd::find_greater(a, T(95)) - a.begin(),
+              std::ranges::find_if(values, [](T x) { return x > T(95); }) - values.begin());
+    ASSERT_EQ(CCircularBufferSimd::count(a, T(3)), std::ranges::count(values, T(3)));
+    ASSERT_EQ(CCircularBufferSimd::count_greater(a, T(50)),
+              std::ranges::count_if(values, [](T x) { return x > T(50); }));
+    CCircularBufferSimd::sum_type<T> sum = 0, dot = 0;
+    for (size_t i = 0; i < values.size(); i++) {
+        sum += values[i];
+        dot += CCircularBufferSimd::sum_type<T>(values[i]) * others[i];
+    }
+    ASSERT_EQ(CCircularBufferSimd::sum(a), sum);
+    ASSERT_EQ(CCircularBufferSimd::dot(a, b), dot);
+    auto [lo, hi] = std::ranges::minmax(values);
+    ASSERT_EQ(CCircularBufferSimd::min_max(a), std::make_pair(lo, hi));
+}
+
+// Small integer values keep every float sum exact, so both paths must agree bit for bit.
+template<class T>
+void CheckSimdPaths() {
+    CCircularBuffer<T> a(1000, T(0));
+    CCircularBuffer<T> b(1000, T(0));
+    for (int i = 0; i < 1337; i++) {
+        a.push_back(T((i * 37) % 101));
+    }
+    for (int i = 0; i < 1210; i++) {
+        b.push_back(T((i * 11) % 23 - 11));
+    }
+    CheckSimd(a, b);
+    CCircularBufferSimd::set_scalar_only(true);
+    CheckSimd(a, b);
+    CCircularBufferSimd::set_scalar_only(false);
+}
+
+TEST (Simd, Float) {
+    CheckSimdPaths<float>();
+}
+
+TEST (Simd, Int32) {
+    CheckSimdPaths<int32_t>();
+}
+
+// NaN propagates on both paths, wherever it sits: in a vector block, in a tail or at the front.
+TEST (Simd, MinMaxNaN) {
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    for (bool scalarOnly : {false, true}) {
+        CCircularBufferSimd::set_scalar_only(scalarOnly);
+        // runs of 27 and 13 elements: 24 + 3 and 8 + 5 between the vector blocks and the tails
+        for (size_t at : {0, 26, 30, 39}) {
+            CCircularBuffer<float> a(40, 0.0f);
+            for (int i = 0; i < 53; i++) {
+                a.push_back(float(i));
+            }
+            auto [lo, hi] = CCircularBufferSimd::min_max(a);
+            ASSERT_EQ(lo, 13);
+            ASSERT_EQ(hi, 52);
+            a[at] = nan;
+            std::tie(lo, hi) = CCircularBufferSimd::min_max(a);
+            ASSERT_TRUE(std::isnan(lo));
+            ASSERT_TRUE(std::isnan(hi));
+        }
+    }
+    CCircularBufferSimd::set_scalar_only(false);
+}
+
+TEST (Simd, OtherTypesAndEmpty) {
+    CCircularBuffer<double> a = {1.5, 2.5, 4};
+    a.push_back(8);
+    ASSERT_EQ(CCircularBufferSimd::sum(a), 14.5);
+    ASSERT_EQ(*CCircularBufferSimd::find_greater(a, 3.0), 4);
+    CCircularBuffer<int32_t> empty;
+    ASSERT_EQ(CCircularBufferSimd::sum(empty), 0);
+    ASSERT_EQ(CCircularBufferSimd::find(empty, 1), empty.end());
+    ASSERT_EQ(CCircularBufferSimd::dot(empty, empty), 0);
+
+    // unsigned sums beyond INT64_MAX
+    const uint64_t big = uint64_t(1) << 62;
+    CCircularBuffer<uint64_t> u = {big, big, big};
+    static_assert(std::is_same_v<decltype(CCircularBufferSimd::sum(u)), uint64_t>);
+    ASSERT_EQ(CCircularBufferSimd::sum(u), 3 * big);
+    CCircularBuffer<uint32_t> v(3, std::numeric_limits<uint32_t>::max());
+    ASSERT_EQ(CCircularBufferSimd::dot(v, v), 3 * uint64_t(std::numeric_limits<uint32_t>::max()) * std::numeric_limits<uint32_t>::max());
+}
+
+TEST (Parallel, ForEachAndReduce) {
+    CCircularBuffer<int64_t> a(100000, 0);
+    for (int i = 0; i < 130001; i++) {
+        a.push_back(i);
+    }
+    ASSERT_FALSE(a.array_two().empty());
+    CCircularBufferParallel::for_each(a, [](int64_t& value) { value *= 2; }, 4);
+    int64_t expected = 0;
+    for (int64_t value : a) {
+        expected += value * value;
+    }
+    int64_t sum = CCircularBufferParallel::transform_reduce(a, int64_t(0), std::plus<>(),
+                                                            [](int64_t value) { return value * value; }, 4);
+    ASSERT_EQ(sum, expected);
+    // string concatenation is not commutative, so the parts must be combined in order
+    CCircularBuffer<std::string> b(40000, "");
+    for (int i = 0; i < 45000; i++) {
+        b.push_back(std::string(1, 'a' + i % 26));
+    }
+    std::string joined = CCircularBufferParallel::transform_reduce(b, std::string(), std::plus<>(),
+                                                                   [](const std::string& value) { return value; }, 3);
+    std::string linear;
+    for (const std::string& value : b) {
+        linear += value;
+    }
+    ASSERT_EQ(joined, linear);
+}
+
+TEST (Parallel, Sort) {
+    CCircularBuffer<int> a(70000, 0);
+    unsigned seed = 1;
+    for (int i = 0; i < 100000; i++) {
+        seed = seed * 1103515245 + 12345;
+        a.push_back(seed >> 8);
+    }
+    std::vector<int> expected(a.begin(), a.end());
+    std::ranges::sort(expected, std::greater<>());
+    CCircularBufferParallel::sort(a, std::greater<>(), 3);
+    ASSERT_TRUE(std::ranges::equal(a, expected));
+    CCircularBuffer<int> small = {3, 1, 2};
+    small.push_back(0);
+    CCircularBufferParallel::sort(small);
+    ASSERT_TRUE(std::ranges::equal(small, std::vector{0, 1, 2}));
+}
+
+TEST (Stats, CountsHotPaths) {
+    CCircularBuffer<int, std::allocator<int>, CAtomicStats> a;
+    a.reserve(4);
+    for (int i = 0; i < 6; i++) {
+        a.push_back(i);
+    }
+    a.pop_front();
+    a.pop_back(2);
+    a.set_full_policy(CFullPolicy::Reject);
+    for (int i = 0; i < 4; i++) {
+        a.push_front(i);
+    }
+    ASSERT_EQ(a.insert(a.begin(), 7), a.end());
+    a.set_full_policy(CFullPolicy::Grow);
+    a.insert(a.begin(), 7);
+    a.erase(a.begin());
+    CBufferStats stats = a.stats();
+    ASSERT_EQ(stats.pushes, 10);
+    ASSERT_EQ(stats.pops, 4);
+    ASSERT_EQ(stats.overwrites, 2);
+    ASSERT_EQ(stats.drops, 2);
+    ASSERT_EQ(stats.maxSize, 5);
+    ASSERT_EQ(stats.reserves, 1);
+    ASSERT_EQ(stats.reallocations, 2);
+    ASSERT_EQ(stats.bytesRelocated, 4 * sizeof(int));
+    a.reset_counters();
+    ASSERT_EQ(a.stats().pushes, 0);
+    ASSERT_EQ(a.stats().maxSize, 0);
+
+    // elements overwritten by a bulk push are not pops
+    a.set_full_policy(CFullPolicy::Overwrite);
+    std::vector<int> values = {1, 2, 3, 4, 5, 6};
+    a.push_back(values.begin(), values.end());
+    a.push_front(values.begin(), values.end());
+    ASSERT_EQ(a.stats().pops, 0);
+    ASSERT_EQ(a.stats().overwrites, a.overwritten());
+
+    CCircularBuffer<int> b = {1, 2};
+    b.push_back(3);
+    b.reserve(10);
+    ASSERT_EQ(b.stats().pushes, 0);
+    ASSERT_EQ(b.stats().reallocations, 0);
+}
+
+template<class T>
+struct LiveAllocator : std::allocator<T> {
+    static inline int live = 0;
+
+    LiveAllocator() = default;
+    template<class U>
+    LiveAllocator(const LiveAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        live++;
+        return std::allocator<T>::allocate(n);
+    }
+
+    void deallocate(T* p, size_t n) {
+        live--;
+        std::allocator<T>::deallocate(p, n);
+    }
+};
+
+TEST (Stats, ExtGrowthAndConcurrentReader) {
+    CCircularBufferExt<int, std::allocator<int>, 0, CAtomicStats> a;
+    std::atomic<bool> done = false;
+    std::thread reader([&] {
+        uint64_t pushes = 0;
+        while (!done.load()) {
+            CBufferStats stats = a.stats();
+            EXPECT_LE(pushes, stats.pushes);
+            pushes = stats.pushes;
+        }
+    });
+    for (int round = 0; round < 100; round++) {
+        for (int i = 0; i < 1000; i++) {
+            a.push_back(i);
+        }
+        while (!a.empty()) {
+            a.pop_front();
+        }
+    }
+    done = true;
+    reader.join();
+    CBufferStats stats = a.stats();
+    ASSERT_EQ(stats.pushes, 100000);
+    ASSERT_EQ(stats.pops, 100000);
+    ASSERT_EQ(stats.maxSize, 1000);
+    // capacity doubles from 1 to 1024; each growth relocates the elements stored at the time
+    ASSERT_EQ(stats.reallocations, 11);
+    ASSERT_EQ(stats.bytesRelocated, 1023 * sizeof(int));
+
+    // incremental growth moves every element once as well, only spread over later pushes
+    CCircularBufferExt<int, std::allocator<int>, 0, CAtomicStats> b;
+    b.set_incremental_growth(4);
+    for (int i = 0; i < 100; i++) {
+        b.push_back(i);
+    }
+    b.clear();
+    ASSERT_EQ(b.stats().reallocations, 8);
+    ASSERT_EQ(b.stats().bytesRelocated, 127 * sizeof(int));
+
+    // a pop that removes the last pending element of a migration frees the old block
+    {
+        CCircularBufferExt<int, LiveAllocator<int>, 0, CAtomicStats> c;
+        c.set_incremental_growth(2);
+        for (int i = 0; i < 9; i++) {
+            c.push_back(i);
+        }
+        while (!c.empty()) {
+            c.pop_back();
+        }
+        ASSERT_EQ(LiveAllocator<int>::live, 1);
+    }
+    ASSERT_EQ(LiveAllocator<int>::live, 0);
+}
+
+TEST (Latency, Histogram) {
+    for (uint64_t v : {0ull, 1ull, 31ull, 32ull, 63ull, 64ull, 65ull, 1000ull, 123456789ull, 1ull << 40, ~0ull}) {
+        size_t bucket = CLatencyHistogram::bucket(v);
+        ASSERT_LT(bucket, CLatencyHistogram::bucketCount);
+        ASSERT_GE(CLatencyHistogram::highest(bucket), v);
+        ASSERT_LE(CLatencyHistogram::highest(bucket) - v, v / 32);
+        if (v != 0) {
+            ASSERT_LE(CLatencyHistogram::bucket(v - 1), bucket);
+        }
+    }
+    CLatencyHistogram h;
+    ASSERT_EQ(h.percentile(50), 0);
+    for (uint64_t v = 1; v <= 1000; v++) {
+        h.record(v);
+    }
+    ASSERT_EQ(h.count(), 1000);
+    ASSERT_EQ(h.min(), 1);
+    ASSERT_EQ(h.max(), 1000);
+    ASSERT_DOUBLE_EQ(h.mean(), 500.5);
+    ASSERT_EQ(h.percentile(1), 10);
+    ASSERT_GE(h.percentile(50), 500);
+    ASSERT_LE(h.percentile(50), 500 + 500 / 32);
+    ASSERT_EQ(h.percentile(100), 1000);
+    h.reset();
+    ASSERT_EQ(h.count(), 0);
+}
+
+TEST (Latency, ResidenceFollowsElements) {
+    using namespace std::chrono_literals;
+    const uint64_t pause = std::chrono::nanoseconds(30ms).count();
+    CCircularBuffer<int, std::allocator<int>, CLatencyStats> a;
+    a.reserve(3);
+    a.push_back(1);
+    std::this_thread::sleep_for(30ms);
+    // overwriting 1 must drop its stamp, so none of these waited for the pause
+    for (int i = 2; i < 5; i++) {
+        a.push_back(i);
+    }
+    a.pop_front(3);
+    ASSERT_EQ(a.stats_policy().latency().count(), 3);
+    ASSERT_LT(a.stats_policy().latency().max(), pause);
+
+    a.push_back(1);
+    std::this_thread::sleep_for(30ms);
+    a.push_front(0);
+    a.insert(a.begin() + 1, 5);
+    a.erase(a.begin());
+    ASSERT_EQ(a.front(), 5);
+    a.pop_front();
+    ASSERT_LT(a.stats_policy().latency().max(), pause);
+    a.pop_back();
+    ASSERT_EQ(a.stats_policy().latency().count(), 5);
+    ASSERT_GE(a.stats_policy().latency().max(), pause);
+    ASSERT_EQ(a.stats().pushes, 7);
+    ASSERT_EQ(a.stats().pops, 6);
+
+    // values that were not pushed carry no stamp
+    CCircularBuffer<int, std::allocator<int>, CLatencyStats> b = {1, 2, 3};
+    b.push_back(4);
+    b.pop_front(4);
+    ASSERT_EQ(b.stats_policy().latency().count(), 1);
+
+    // the side ring stays in step through growth, bulk pushes and both ends
+    CCircularBufferExt<int, std::allocator<int>, 0, CLatencyStats> c;
+    std::vector<int> values(50, 0);
+    uint64_t pops = 0;
+    for (int round = 0; round < 20; round++) {
+        c.push_back(values.begin(), values.end());
+        c.push_front(round);
+        c.insert(c.begin() + c.size() / 2, round);
+        c.erase(c.begin() + c.size() / 3);
+        c.pop_back(10);
+        c.pop_front();
+        pops += 11;
+    }
+    pops += c.size();
+    c.pop_front(c.size());
+    ASSERT_EQ(c.stats_policy().latency().count(), pops);
+    std::ostringstream out;
+    c.stats_policy().latency().print(out);
+    ASSERT_NE(out.str().find("99.9\t"), std::string::npos);
+}